@@ -0,0 +1,57 @@
+// Times millions of small arena allocations spread over many chunks.
+// Usage: arena_bench [MILLIONS]
+//
+// For a range of first-chunk sizes, allocates MILLIONS (default 20) million blocks of 8 to 64 bytes,
+// then rewinds and allocates them all again into the chunks already mapped. Prints one JSON object
+// per line with the number of chunks and the nanoseconds per allocation of each pass.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sdm_lib.h"
+
+// Not used here, but sdm_lib.c refers to them
+void *active_alloc(size_t size) { (void)size; return NULL; }
+void *active_realloc(void *ptr, size_t old_size, size_t size) { (void)ptr; (void)old_size; (void)size; return NULL; }
+sdm_arena_t *swap_active_arena(sdm_arena_t *arena) { return arena; }
+sdm_arena_t *scratch_arena(void) { return NULL; }
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Returns the seconds taken to make count allocations, and writes to each so the pages are used
+static double fill(sdm_arena_t *arena, size_t count) {
+  uint32_t state = 12345;
+  double start = now();
+  for (size_t i=0; i<count; i++) {
+    state = state * 1664525u + 1013904223u;
+    size_t size = 8 + ((state >> 24) & 56);
+    unsigned char *p = sdm_arena_alloc(arena, size);
+    p[0] = (unsigned char)i;
+  }
+  return now() - start;
+}
+
+int main(int argc, char **argv) {
+  size_t count = (argc > 1 ? strtoull(argv[1], NULL, 10) : 20) * 1000000;
+  static const size_t first_chunk[] = { 4 << 10, 64 << 10, 1 << 20, 16 << 20, 256 << 20 };
+
+  for (size_t c=0; c<sizeof(first_chunk)/sizeof(first_chunk[0]); c++) {
+    sdm_arena_t arena = { .capacity = first_chunk[c] };
+    double first = fill(&arena, count);
+    size_t chunks = sdm_arena_chunks(&arena);
+    size_t used = sdm_arena_used(&arena);
+    sdm_arena_rewind(&arena, (sdm_arena_mark){0});
+    double again = fill(&arena, count);
+    printf("{\"first_chunk\": %zu, \"allocations\": %zu, \"bytes\": %zu, \"chunks\": %zu, "
+           "\"ns_per_alloc\": %.2f, \"ns_per_alloc_after_rewind\": %.2f}\n",
+           first_chunk[c], count, used, chunks, first * 1e9 / count, again * 1e9 / count);
+    sdm_arena_free(&arena);
+  }
+  return 0;
+}
@@ -0,0 +1,200 @@
+// Writes a synthetic LL lattice of a given size to stdout, for benchmarking.
+// Usage: gen_lattice [--size MB] [--elements N] [--lines N] [--depth N] [--comments N] [--digits N] [--seed N]
+//
+// The lattice is made of blocks. Each block has a comment banner of --comments lines, --elements
+// element definitions with float literals of --digits significant digits, and --lines `Line`
+// definitions whose expressions nest `Line(...)`, negation and repetition up to --depth deep.
+// Blocks are repeated until the output is at least --size megabytes. The same seed always gives
+// the same file, and every file passes the validator.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  size_t size;
+  size_t elements;
+  size_t lines;
+  size_t depth;
+  size_t comments;
+  int digits;
+  uint64_t seed;
+} LatticeShape;
+
+typedef struct {
+  const char *type;
+  const char *params[3];
+} ElementKind;
+
+static const ElementKind element_kinds[] = {
+  { "Drift",     { "L", NULL, NULL } },
+  { "Quad",      { "L", "K1", NULL } },
+  { "Bend",      { "L", "Phi", "K1" } },
+  { "Sextupole", { "L", "K2", NULL } },
+  { "Octupole",  { "L", "K3", NULL } },
+};
+#define ELEMENT_KIND_COUNT (sizeof(element_kinds) / sizeof(element_kinds[0]))
+
+static const char *comment_words[] = {
+  "the", "lattice", "cell", "focusing", "defocusing", "dipole", "quadrupole", "drift", "space",
+  "between", "magnets", "is", "matched", "to", "injection", "optics", "with", "chromaticity",
+  "corrected", "by", "sextupoles", "in", "each", "arc", "let", "tune", "beta", "function",
+};
+#define COMMENT_WORD_COUNT (sizeof(comment_words) / sizeof(comment_words[0]))
+
+static uint64_t rng_state;
+
+// xorshift64*, so the output does not depend on the C library
+static uint64_t rng_next(void) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static size_t rng_below(size_t n) {
+  return rng_next() % n;
+}
+
+static double rng_unit(void) {
+  return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static size_t written = 0;
+
+__attribute__((format(printf, 1, 2)))
+static void emit(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int n = vprintf(fmt, args);
+  va_end(args);
+  if (n > 0) written += n;
+}
+
+static void emit_comments(const LatticeShape *shape, size_t block) {
+  if (shape->comments == 0) return;
+  emit("// ******************************************************************************************\n");
+  emit("// Block %zu\n", block);
+  for (size_t i=2; i<shape->comments; i++) {
+    emit("//");
+    size_t words = 6 + rng_below(10);
+    for (size_t w=0; w<words; w++) emit(" %s", comment_words[rng_below(COMMENT_WORD_COUNT)]);
+    emit("\n");
+  }
+}
+
+static void emit_float(int digits) {
+  double value = (rng_unit() - 0.5) * 20.0;
+  if (rng_below(4) == 0) emit("%.*e", digits - 1, value * 1e4);
+  else emit("%.*f", digits, value);
+}
+
+static void emit_element(const LatticeShape *shape, size_t block, size_t i) {
+  const ElementKind *kind = &element_kinds[i % ELEMENT_KIND_COUNT];
+  emit("let e%zu_%zu: %s = %s(", block, i, kind->type, kind->type);
+  for (size_t p=0; p<3 && kind->params[p] != NULL; p++) {
+    emit("%s %s = ", p > 0 ? "," : "", kind->params[p]);
+    emit_float(shape->digits);
+  }
+  emit(" );\n");
+}
+
+// An element or an earlier line of the same block
+static void emit_operand(const LatticeShape *shape, size_t block, size_t line) {
+  if (line > 0 && rng_below(3) == 0) emit("l%zu_%zu", block, rng_below(line));
+  else emit("e%zu_%zu", block, rng_below(shape->elements));
+}
+
+static void emit_expression(const LatticeShape *shape, size_t block, size_t line, size_t depth) {
+  size_t choice = rng_below(depth > 0 ? 5 : 3);
+  switch (choice) {
+    case 0: {
+      emit_operand(shape, block, line);
+    } break;
+    case 1: {
+      emit("-");
+      emit_operand(shape, block, line);
+    } break;
+    case 2: {
+      emit("%zu * ", 2 + rng_below(30));
+      emit_operand(shape, block, line);
+    } break;
+    case 3: {
+      size_t count = 2 + rng_below(5);
+      emit("Line(");
+      for (size_t i=0; i<count; i++) {
+        if (i > 0) emit(", ");
+        emit_expression(shape, block, line, depth - 1);
+      }
+      emit(")");
+    } break;
+    case 4: {
+      if (rng_below(2)) emit("-");
+      else emit("%zu * ", 2 + rng_below(10));
+      emit("Line(");
+      emit_expression(shape, block, line, depth - 1);
+      emit(rng_below(2) ? " + " : " - ");
+      emit_expression(shape, block, line, depth - 1);
+      emit(")");
+    } break;
+  }
+}
+
+static void emit_line(const LatticeShape *shape, size_t block, size_t line) {
+  emit("let l%zu_%zu: Line = ", block, line);
+  emit_expression(shape, block, line, shape->depth);
+  emit(";\n");
+}
+
+static void usage(const char *program) {
+  fprintf(stderr, "Usage: %s [--size MB] [--elements N] [--lines N] [--depth N] [--comments N] [--digits N] [--seed N]\n", program);
+}
+
+int main(int argc, char **argv) {
+  LatticeShape shape = {
+    .size = 8,
+    .elements = 32,
+    .lines = 8,
+    .depth = 4,
+    .comments = 12,
+    .digits = 17,
+    .seed = 1,
+  };
+
+  for (int i=1; i<argc; i++) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    const char *arg = argv[i];
+    unsigned long long value = strtoull(argv[++i], NULL, 10);
+    if (strcmp(arg, "--size") == 0) shape.size = value;
+    else if (strcmp(arg, "--elements") == 0) shape.elements = value;
+    else if (strcmp(arg, "--lines") == 0) shape.lines = value;
+    else if (strcmp(arg, "--depth") == 0) shape.depth = value;
+    else if (strcmp(arg, "--comments") == 0) shape.comments = value;
+    else if (strcmp(arg, "--digits") == 0) shape.digits = (int)value;
+    else if (strcmp(arg, "--seed") == 0) shape.seed = value;
+    else {
+      fprintf(stderr, "Unknown option: %s\n", arg);
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (shape.elements == 0 || shape.digits < 1 || shape.digits > 40) {
+    fprintf(stderr, "--elements must be positive and --digits between 1 and 40\n");
+    return 1;
+  }
+
+  rng_state = shape.seed * 0x9E3779B97F4A7C15ULL + 1;
+  size_t target = shape.size << 20;
+  for (size_t block=0; written < target || block == 0; block++) {
+    emit_comments(&shape, block);
+    for (size_t i=0; i<shape.elements; i++) emit_element(&shape, block, i);
+    for (size_t i=0; i<shape.lines; i++) emit_line(&shape, block, i);
+    emit("\n");
+  }
+  return 0;
+}
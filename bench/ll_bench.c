@@ -0,0 +1,271 @@
+// Times each stage of the ll pipeline on the given inputs.
+// Usage: ll_bench [--runs N] [--threads N] FILE...
+//
+// Prints one JSON object per line for every file and stage, with the best time over the runs, the
+// throughput, and the arena bytes the stage allocated, including the parallel lexer's per-thread
+// arenas. The stages are the ones main goes through: mapping the file, lexing it (with each lexer,
+// zero-copy, on several threads, or fused with validation), validating, parsing, the token cache
+// and printing.
+
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "app_arena.h"
+#include "parser.h"
+#include "token_cache.h"
+#include "token_lib.h"
+
+typedef enum {
+  STAGE_READ,
+  STAGE_TOKENISE,
+  STAGE_TOKENISE_DFA,
+  STAGE_TOKENISE_ZERO_COPY,
+  STAGE_TOKENISE_PARALLEL,
+  STAGE_FUSED,
+  STAGE_VALIDATE,
+  STAGE_PARSE,
+  STAGE_LINES,
+  STAGE_CACHE_STORE,
+  STAGE_CACHE_LOAD,
+  STAGE_PRINT,
+  STAGE_COUNT,
+} BenchStage;
+
+static const char *stage_names[STAGE_COUNT] = {
+  [STAGE_READ]               = "read",
+  [STAGE_TOKENISE]           = "tokenise",
+  [STAGE_TOKENISE_DFA]       = "tokenise_dfa",
+  [STAGE_TOKENISE_ZERO_COPY] = "tokenise_zero_copy",
+  [STAGE_TOKENISE_PARALLEL]  = "tokenise_parallel",
+  [STAGE_FUSED]              = "fused",
+  [STAGE_VALIDATE]           = "validate",
+  [STAGE_PARSE]              = "parse",
+  [STAGE_LINES]              = "lines",
+  [STAGE_CACHE_STORE]        = "cache_store",
+  [STAGE_CACHE_LOAD]         = "cache_load",
+  [STAGE_PRINT]              = "print",
+};
+
+typedef struct {
+  double seconds;
+  size_t tokens;
+  size_t arena_bytes;
+} BenchResult;
+
+typedef struct {
+  const char *filename;
+  sdm_string_view contents;
+  const char *cache_dir;
+  size_t thread_count;
+} BenchInput;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_tokenise(const BenchInput *input, sdm_interner *symbols, TokenArray *t_array, LexerKind lexer, bool zero_copy) {
+  Tokeniser tokeniser = {
+    .filename = input->filename,
+    .contents = input->contents,
+    .lexer = lexer,
+    .zero_copy = zero_copy,
+    .symbols = symbols,
+  };
+  tokenise_input_file(&tokeniser, t_array);
+}
+
+static void bench_fail(const BenchInput *input, BenchStage stage) {
+  fprintf(stderr, "ERROR: Stage %s failed on %s\n", stage_names[stage], input->filename);
+  exit(1);
+}
+
+// Runs the setup a stage needs, then the stage itself. Only the stage is timed, and only its
+// allocations are counted.
+static BenchResult bench_stage(const BenchInput *input, BenchStage stage) {
+  sdm_interner symbols = {0};
+  TokenArray t_array = {0};
+  double start = 0.0, elapsed = 0.0;
+  size_t arena_base = 0;
+  size_t segment_arena_bytes = 0;
+#define BENCH_START() (arena_base = sdm_arena_used(&main_arena), start = now())
+  switch (stage) {
+    case STAGE_READ: {
+      BENCH_START();
+      sdm_string_view contents = sdm_map_entire_file(input->filename);
+      // Touch every page, as lexing would
+      volatile unsigned char sum = 0;
+      for (size_t i=0; i<contents.length; i+=4096) sum += contents.data[i];
+      elapsed = now() - start;
+      sdm_unmap_file(contents);
+    } break;
+    case STAGE_TOKENISE:
+    case STAGE_TOKENISE_DFA:
+    case STAGE_TOKENISE_ZERO_COPY: {
+      BENCH_START();
+      bench_tokenise(input, &symbols, &t_array, stage == STAGE_TOKENISE_DFA ? LEXER_DFA : LEXER_LADDER,
+                     stage == STAGE_TOKENISE_ZERO_COPY);
+      elapsed = now() - start;
+    } break;
+    case STAGE_TOKENISE_PARALLEL: {
+      Tokeniser tokeniser = { .filename = input->filename, .contents = input->contents, .symbols = &symbols };
+      BENCH_START();
+      segment_arena_bytes = tokenise_input_file_parallel(&tokeniser, &t_array, input->thread_count);
+      elapsed = now() - start;
+    } break;
+    case STAGE_FUSED: {
+      Tokeniser tokeniser = { .filename = input->filename, .contents = input->contents, .symbols = &symbols };
+      BENCH_START();
+      bool valid = tokenise_and_validate(&tokeniser, &t_array);
+      elapsed = now() - start;
+      if (!valid) bench_fail(input, stage);
+    } break;
+    case STAGE_VALIDATE: {
+      bench_tokenise(input, &symbols, &t_array, LEXER_LADDER, false);
+      BENCH_START();
+      bool valid = validate_token_array(&t_array);
+      elapsed = now() - start;
+      if (!valid) bench_fail(input, stage);
+    } break;
+    case STAGE_PARSE: {
+      bench_tokenise(input, &symbols, &t_array, LEXER_LADDER, false);
+      Ast ast = {0};
+      BENCH_START();
+      bool valid = parse_token_array(&t_array, &ast);
+      elapsed = now() - start;
+      if (!valid) {
+        print_parse_diagnostics(&ast);
+        bench_fail(input, stage);
+      }
+    } break;
+    case STAGE_LINES: {
+      bench_tokenise(input, &symbols, &t_array, LEXER_LADDER, false);
+      BENCH_START();
+      token_array_line_count(&t_array);
+      elapsed = now() - start;
+    } break;
+    case STAGE_CACHE_STORE: {
+      bench_tokenise(input, &symbols, &t_array, LEXER_LADDER, true);
+      BENCH_START();
+      token_cache_store(input->cache_dir, &t_array);
+      elapsed = now() - start;
+    } break;
+    case STAGE_CACHE_LOAD: {
+      Tokeniser tokeniser = { .filename = input->filename, .contents = input->contents, .symbols = &symbols };
+      sdm_string_view mapping;
+      BENCH_START();
+      bool hit = token_cache_load(input->cache_dir, &tokeniser, &t_array, &mapping);
+      elapsed = now() - start;
+      if (!hit) bench_fail(input, stage);
+      sdm_unmap_file(mapping);
+    } break;
+    case STAGE_PRINT: {
+      bench_tokenise(input, &symbols, &t_array, LEXER_LADDER, false);
+      // Print to /dev/null, so only the formatting is measured
+      fflush(stdout);
+      int saved_stdout = dup(STDOUT_FILENO);
+      int null_fd = open("/dev/null", O_WRONLY);
+      if (saved_stdout < 0 || null_fd < 0) bench_fail(input, stage);
+      dup2(null_fd, STDOUT_FILENO);
+      BENCH_START();
+      print_token_array(&t_array);
+      fflush(stdout);
+      elapsed = now() - start;
+      dup2(saved_stdout, STDOUT_FILENO);
+      close(null_fd);
+      close(saved_stdout);
+    } break;
+    case STAGE_COUNT: break;
+  }
+#undef BENCH_START
+  return (BenchResult){
+    .seconds = elapsed,
+    .tokens = t_array.length,
+    .arena_bytes = sdm_arena_used(&main_arena) - arena_base + segment_arena_bytes,
+  };
+}
+
+static void usage(const char *program) {
+  fprintf(stderr, "Usage: %s [--runs N] [--threads N] FILE...\n", program);
+}
+
+int main(int argc, char **argv) {
+  char *program = sdm_shift_args(&argc, &argv);
+  int runs = 5;
+  size_t thread_count = 4;
+  const char **filenames = malloc((argc + 1) * sizeof(filenames[0]));
+  size_t file_count = 0;
+
+  while (argc > 0) {
+    char *arg = sdm_shift_args(&argc, &argv);
+    if (strcmp(arg, "--runs") == 0 || strcmp(arg, "--threads") == 0) {
+      char *count = sdm_shift_args(&argc, &argv);
+      if (count == NULL || atoi(count) < 1) {
+        fprintf(stderr, "%s needs a positive number\n", arg);
+        usage(program);
+        return 1;
+      }
+      if (strcmp(arg, "--runs") == 0) runs = atoi(count);
+      else thread_count = atoi(count);
+    } else if (arg[0] == '-') {
+      fprintf(stderr, "Unknown option: %s\n", arg);
+      usage(program);
+      return 1;
+    } else {
+      filenames[file_count++] = arg;
+    }
+  }
+  if (file_count == 0) {
+    usage(program);
+    return 1;
+  }
+
+  char cache_dir[] = "/tmp/ll_bench_XXXXXX";
+  if (mkdtemp(cache_dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  for (size_t f=0; f<file_count; f++) {
+    BenchInput input = {
+      .filename = filenames[f],
+      .contents = sdm_map_entire_file(filenames[f]),
+      .cache_dir = cache_dir,
+      .thread_count = thread_count,
+    };
+    for (BenchStage stage=0; stage<STAGE_COUNT; stage++) {
+      BenchResult best = {0};
+      for (int run=0; run<runs; run++) {
+        // Forget everything allocated, but keep the chunks so later runs don't pay for fresh memory
+        sdm_arena_rewind(&main_arena, (sdm_arena_mark){0});
+        BenchResult result = bench_stage(&input, stage);
+        if (run == 0 || result.seconds < best.seconds) best.seconds = result.seconds;
+        if (result.arena_bytes > best.arena_bytes) best.arena_bytes = result.arena_bytes;
+        best.tokens = result.tokens;
+      }
+      double mb = input.contents.length / (1024.0 * 1024.0);
+      double seconds = best.seconds > 0 ? best.seconds : 1e-9;
+      printf("{\"file\": \"%s\", \"stage\": \"%s\", \"bytes\": %zu, \"tokens\": %zu, \"runs\": %d, "
+             "\"seconds\": %.6f, \"mb_per_s\": %.1f, \"tokens_per_s\": %.0f, \"arena_bytes\": %zu}\n",
+             input.filename, stage_names[stage], input.contents.length, best.tokens, runs,
+             best.seconds, mb / seconds, best.tokens / seconds, best.arena_bytes);
+      fflush(stdout);
+    }
+
+    char path[sizeof(cache_dir) + 32];
+    snprintf(path, sizeof(path), "%s/%016llx.llt", cache_dir,
+             (unsigned long long)sdm_hash_bytes(input.contents.data, input.contents.length));
+    remove(path);
+    sdm_unmap_file(input.contents);
+  }
+  remove(cache_dir);
+  free(filenames);
+  app_arena_free();
+  return 0;
+}
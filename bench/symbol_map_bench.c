@@ -0,0 +1,77 @@
+// Times SDM_MAP(double), the map for names and their values.
+// Usage: symbol_map_bench
+//
+// For tables of different sizes, times inserting every name, looking up names that are there, and
+// looking up names that are not. Prints one JSON object per line with the nanoseconds per operation.
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_arena.h"
+
+#define HIT_LOOKUPS 2000000
+#define MISS_LOOKUPS 200000
+#define NAME_SIZE 32
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Names like the ones in a lattice file: a few constants, then elements and lines per block
+static void make_name(char *name, size_t i, bool missing) {
+  static const char *constants[] = { "h_rf", "c0", "periods", "circumference", "zero", "bpm" };
+  size_t constant_count = sizeof(constants) / sizeof(constants[0]);
+  if (!missing && i < constant_count) snprintf(name, NAME_SIZE, "%s", constants[i]);
+  else snprintf(name, NAME_SIZE, "%s%zu_%zu", missing ? "m" : (i % 4 ? "e" : "l"), i / 32, i % 32);
+}
+
+static void report(const char *map, size_t size, const char *op, double seconds, size_t count) {
+  printf("{\"map\": \"%s\", \"size\": %zu, \"op\": \"%s\", \"ns_per_op\": %.2f}\n", map, size, op, seconds * 1e9 / count);
+  fflush(stdout);
+}
+
+static void bench_sdm_map(char (*names)[NAME_SIZE], char (*missing)[NAME_SIZE], size_t size) {
+  SDM_MAP(double) map = {0};
+  double start = now();
+  for (size_t i=0; i<size; i++) SDM_MAP_SET(map, sdm_cstr_as_sv(names[i]), (double)i);
+  report("SDM_MAP", size, "insert", now() - start, size);
+
+  double sum = 0.0, *value;
+  start = now();
+  for (size_t i=0; i<HIT_LOOKUPS; i++) {
+    SDM_MAP_GET(map, sdm_cstr_as_sv(names[i % size]), value);
+    if (value) sum += *value;
+  }
+  report("SDM_MAP", size, "hit", now() - start, HIT_LOOKUPS);
+
+  start = now();
+  for (size_t i=0; i<MISS_LOOKUPS; i++) {
+    SDM_MAP_GET(map, sdm_cstr_as_sv(missing[i % size]), value);
+    if (value) sum += *value;
+  }
+  report("SDM_MAP", size, "miss", now() - start, MISS_LOOKUPS);
+  if (sum < 0) printf("%f\n", sum);
+}
+
+int main(void) {
+  static const size_t sizes[] = { 16, 256, 4096, 65536 };
+  for (size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+    size_t size = sizes[s];
+    char (*names)[NAME_SIZE] = malloc(size * sizeof(names[0]));
+    char (*missing)[NAME_SIZE] = malloc(size * sizeof(missing[0]));
+    for (size_t i=0; i<size; i++) {
+      make_name(names[i], i, false);
+      make_name(missing[i], i, true);
+    }
+    bench_sdm_map(names, missing, size);
+    free(names);
+    free(missing);
+  }
+  app_arena_free();
+  return 0;
+}
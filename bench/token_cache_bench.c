@@ -0,0 +1,89 @@
+// Compares lexing an input against loading its tokens from the token cache.
+// Usage: token_cache_bench FILE [MEGABYTES]
+// The file is repeated until the input is about MEGABYTES long (default 16).
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "app_arena.h"
+#include "token_cache.h"
+
+#define BENCH_RUNS 5
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s FILE [MEGABYTES]\n", argv[0]);
+    return 1;
+  }
+  size_t target = (argc > 2 ? strtoull(argv[2], NULL, 10) : 16) << 20;
+  char *source = sdm_read_entire_file(argv[1]);
+  size_t source_length = strlen(source);
+  if (source_length == 0) {
+    fprintf(stderr, "ERROR: %s is empty\n", argv[1]);
+    return 1;
+  }
+  size_t copies = (target + source_length - 1) / source_length;
+  char *input = SDM_MALLOC(copies * source_length + 1);
+  for (size_t i=0; i<copies; i++) memcpy(input + i*source_length, source, source_length);
+  input[copies * source_length] = '\0';
+  sdm_string_view contents = sdm_sized_str_as_sv(input, copies * source_length);
+
+  char cache_dir[] = "/tmp/ll_cache_bench_XXXXXX";
+  if (mkdtemp(cache_dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  double lex_best = 1e9, load_best = 1e9;
+  size_t token_count = 0;
+  for (int run=0; run<BENCH_RUNS; run++) {
+    sdm_interner symbols = {0};
+    Tokeniser tokeniser = { .filename = argv[1], .contents = contents, .symbols = &symbols, .zero_copy = true };
+    TokenArray t_array = {0};
+    double start = now();
+    tokenise_input_file(&tokeniser, &t_array);
+    double elapsed = now() - start;
+    if (elapsed < lex_best) lex_best = elapsed;
+    token_count = t_array.length;
+    if (run == 0) token_cache_store(cache_dir, &t_array);
+  }
+  for (int run=0; run<BENCH_RUNS; run++) {
+    sdm_interner symbols = {0};
+    Tokeniser tokeniser = { .filename = argv[1], .contents = contents, .symbols = &symbols };
+    TokenArray t_array = {0};
+    sdm_string_view mapping;
+    double start = now();
+    if (!token_cache_load(cache_dir, &tokeniser, &t_array, &mapping)) {
+      fprintf(stderr, "ERROR: The token cache in %s could not be loaded\n", cache_dir);
+      return 1;
+    }
+    double elapsed = now() - start;
+    if (elapsed < load_best) load_best = elapsed;
+    if (t_array.length != token_count) {
+      fprintf(stderr, "ERROR: Loaded %zu tokens, lexed %zu\n", t_array.length, token_count);
+      return 1;
+    }
+    sdm_unmap_file(mapping);
+  }
+
+  char path[sizeof(cache_dir) + 32];
+  snprintf(path, sizeof(path), "%s/%016llx.llt", cache_dir,
+           (unsigned long long)sdm_hash_bytes(contents.data, contents.length));
+  remove(path);
+  remove(cache_dir);
+
+  double mb = contents.length / (1024.0 * 1024.0);
+  printf("input: %.1f MB, %zu tokens, best of %d runs\n", mb, token_count, BENCH_RUNS);
+  printf("lex:        %8.2f ms  %8.1f MB/s\n", lex_best * 1e3, mb / lex_best);
+  printf("cache load: %8.2f ms  %8.1f MB/s  (%.1fx)\n", load_best * 1e3, mb / load_best, lex_best / load_best);
+  return 0;
+}
@@ -0,0 +1,34 @@
+#include <stdatomic.h>
+
+#include "app_arena.h"
+
+sdm_arena_t main_arena = {0};
+static _Thread_local sdm_arena_t *active_arena = &main_arena;
+
+static atomic_size_t realloc_copies = 0;
+
+void *active_alloc(size_t size) { return sdm_arena_alloc(active_arena, size); }
+void *active_realloc(void *ptr, size_t old_size, size_t size) {
+  void *moved = sdm_arena_realloc(active_arena, ptr, old_size, size);
+  if (ptr != NULL && moved != ptr) atomic_fetch_add_explicit(&realloc_copies, 1, memory_order_relaxed);
+  return moved;
+}
+
+sdm_arena_t *swap_active_arena(sdm_arena_t *arena) {
+  sdm_arena_t *previous = active_arena;
+  active_arena = arena;
+  return previous;
+}
+
+// Scratch work is small, so its arena starts with a much smaller chunk than the main one
+#define SCRATCH_ARENA_CAPACITY (1024*1024)
+static _Thread_local sdm_arena_t scratch = { .capacity = SCRATCH_ARENA_CAPACITY };
+
+sdm_arena_t *scratch_arena(void) { return &scratch; }
+
+size_t app_arena_realloc_copies(void) { return atomic_load(&realloc_copies); }
+
+void app_arena_free(void) {
+  sdm_arena_free(&main_arena);
+  sdm_arena_free(&scratch);
+}
@@ -0,0 +1,17 @@
+#ifndef _APP_ARENA_H
+#define _APP_ARENA_H
+
+#include "sdm_lib.h"
+
+// The arenas the ll programs allocate from, and the active_alloc, active_realloc, swap_active_arena
+// and scratch_arena hooks sdm_lib.h leaves to the application. Everything goes in main_arena unless
+// swap_active_arena says otherwise. Each thread has its own scratch arena.
+extern sdm_arena_t main_arena;
+
+// The times SDM_ARRAY_PUSH and friends had to move an array to grow it
+size_t app_arena_realloc_copies(void);
+
+// Frees main_arena and the calling thread's scratch arena
+void app_arena_free(void);
+
+#endif // _APP_ARENA_H
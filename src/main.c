@@ -1,42 +1,311 @@
+// For clock_gettime when building with -std=c18
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
+#include "app_arena.h"
+#include "parser.h"
+#include "token_cache.h"
 #include "token_lib.h"
 
-static sdm_arena_t main_arena = {0};
-static sdm_arena_t *active_arena = &main_arena;
+typedef enum {
+  PHASE_READ,
+  PHASE_CACHE_LOAD,
+  PHASE_TOKENISE,
+  PHASE_VALIDATE,
+  PHASE_PARSE,
+  PHASE_CACHE_STORE,
+  PHASE_PRINT,
+  PHASE_COUNT,
+} Phase;
+
+static const char *phase_names[PHASE_COUNT] = {
+  [PHASE_READ]        = "read",
+  [PHASE_CACHE_LOAD]  = "cache_load",
+  [PHASE_TOKENISE]    = "tokenise",
+  [PHASE_VALIDATE]    = "validate",
+  [PHASE_PARSE]       = "parse",
+  [PHASE_CACHE_STORE] = "cache_store",
+  [PHASE_PRINT]       = "print",
+};
 
-void *active_alloc(size_t size)              { return sdm_arena_alloc(active_arena, size); }
-void *active_realloc(void *ptr, size_t size) { return sdm_arena_realloc(active_arena, ptr, size); }
+typedef enum {
+  STATS_NONE = 0,
+  STATS_TABLE,
+  STATS_JSON,
+} StatsFormat;
 
-int main(void) {
+typedef struct {
+  double seconds[PHASE_COUNT];
+  size_t tokens[TOKEN_TYPE_COUNT];
+  size_t token_count;
+  size_t ast_nodes;
+  size_t input_bytes;
+  size_t segment_arena_bytes;  // Used by the parallel lexer's per-thread arenas, which are gone by now
+} PipelineStats;
+
+static double monotonic_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Brackets a phase: PHASE_BEGIN(stats, p); ...; PHASE_END(stats, p); The phase may run more than once.
+#define PHASE_BEGIN(stats, phase) double phase##_start = monotonic_seconds()
+#define PHASE_END(stats, phase) (stats).seconds[(phase)] += monotonic_seconds() - phase##_start
+
+static void count_token_types(PipelineStats *stats, const TokenArray *t_array) {
+  for (size_t i=0; i<t_array->length; i++) stats->tokens[t_array->types[i]]++;
+  stats->token_count += t_array->length;
+}
+
+// Written to stderr, so the tokens on stdout are unaffected
+static void print_stats(const PipelineStats *stats, StatsFormat format) {
+  double total = 0.0;
+  for (Phase p=0; p<PHASE_COUNT; p++) total += stats->seconds[p];
+  size_t arena_bytes = sdm_arena_used(&main_arena) + stats->segment_arena_bytes;
+  size_t arena_chunks = sdm_arena_chunks(&main_arena);
+  size_t copies = app_arena_realloc_copies();
+
+  if (format == STATS_JSON) {
+    fprintf(stderr, "{\"input_bytes\": %zu, \"seconds\": {", stats->input_bytes);
+    for (Phase p=0; p<PHASE_COUNT; p++) {
+      fprintf(stderr, "%s\"%s\": %.6f", p > 0 ? ", " : "", phase_names[p], stats->seconds[p]);
+    }
+    fprintf(stderr, ", \"total\": %.6f}, \"tokens\": {", total);
+    for (TokenType t=0; t<TOKEN_TYPE_COUNT; t++) {
+      fprintf(stderr, "%s\"%s\": %zu", t > 0 ? ", " : "", TT_string[t], stats->tokens[t]);
+    }
+    fprintf(stderr, ", \"total\": %zu}, \"ast_nodes\": %zu, \"arena_bytes\": %zu, \"arena_chunks\": %zu, \"realloc_copies\": %zu}\n",
+            stats->token_count, stats->ast_nodes, arena_bytes, arena_chunks, copies);
+    return;
+  }
+
+  fprintf(stderr, "%-24s %12s %8s\n", "phase", "ms", "%");
+  for (Phase p=0; p<PHASE_COUNT; p++) {
+    fprintf(stderr, "%-24s %12.3f %7.1f%%\n", phase_names[p], stats->seconds[p] * 1e3,
+            total > 0 ? 100.0 * stats->seconds[p] / total : 0.0);
+  }
+  fprintf(stderr, "%-24s %12.3f\n\n", "total", total * 1e3);
+  fprintf(stderr, "%-24s %12s\n", "token type", "count");
+  for (TokenType t=0; t<TOKEN_TYPE_COUNT; t++) {
+    if (stats->tokens[t] > 0) fprintf(stderr, "%-24s %12zu\n", TT_string[t], stats->tokens[t]);
+  }
+  fprintf(stderr, "%-24s %12zu\n\n", "total", stats->token_count);
+  if (stats->ast_nodes > 0) fprintf(stderr, "%-24s %12zu\n", "ast nodes", stats->ast_nodes);
+  fprintf(stderr, "%-24s %12zu\n", "input bytes", stats->input_bytes);
+  fprintf(stderr, "%-24s %12zu\n", "arena bytes", arena_bytes);
+  fprintf(stderr, "%-24s %12zu\n", "arena chunks", arena_chunks);
+  fprintf(stderr, "%-24s %12zu\n", "realloc copies", copies);
+}
+
+void usage(const char *program) {
+  fprintf(stderr, "Usage: %s [--dfa] [--zero-copy] [--stream] [--threads N] [--fused] [--parse] [--cache DIR] [--stats] [--stats-json] [input_file]\n", program);
+  fprintf(stderr, "  --dfa          Use the table-driven lexer instead of the default one\n");
+  fprintf(stderr, "  --zero-copy    Identifier and string tokens point into the input instead of owning a copy\n");
+  fprintf(stderr, "  --stream       Read the input in chunks and print tokens as they are lexed. Use - for stdin\n");
+  fprintf(stderr, "  --threads N    Lex large inputs on up to N threads\n");
+  fprintf(stderr, "  --fused        Validate tokens as they are lexed, in a single pass on one thread. Not with\n");
+  fprintf(stderr, "                 --stream, --threads or --parse. Tokens from the cache are validated on their own\n");
+  fprintf(stderr, "  --parse        Parse the tokens instead of validating them, and print the syntax tree\n");
+  fprintf(stderr, "  --cache DIR    Reuse the tokens of an identical input lexed before, keeping them in DIR\n");
+  fprintf(stderr, "  --stats        Print the time spent in each phase, token counts and memory use to stderr\n");
+  fprintf(stderr, "  --stats-json   As --stats, but as a single line of JSON\n");
+}
+
+// stats is NULL unless they were asked for. Splitting the time between lexing and printing takes two
+// clock reads per token, which would be most of the cost of a small token.
+int stream_input_file(const char *input_filename, LexerKind lexer, PipelineStats *stats) {
+  bool from_stdin = strcmp(input_filename, "-") == 0;
+  FILE *f = from_stdin ? stdin : fopen(input_filename, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Could not read %s: %s\n", input_filename, strerror(errno));
+    return 1;
+  }
+
+  TokenStream stream;
+  token_stream_init(&stream, input_filename, lexer, token_stream_read_file, f, TOKEN_STREAM_DEFAULT_CHUNK);
+  size_t token_count = 0;
+  Token token;
+  if (stats == NULL) {
+    while (token_stream_next(&stream, &token)) {
+      print_token(token);
+      token_count++;
+    }
+  } else {
+    // Reading is part of lexing here, so its time is counted under tokenise
+    double start = monotonic_seconds();
+    while (token_stream_next(&stream, &token)) {
+      double lexed = monotonic_seconds();
+      print_token(token);
+      double printed = monotonic_seconds();
+      stats->seconds[PHASE_TOKENISE] += lexed - start;
+      stats->seconds[PHASE_PRINT] += printed - lexed;
+      stats->tokens[token.token_type]++;
+      start = printed;
+      token_count++;
+    }
+    stats->seconds[PHASE_TOKENISE] += monotonic_seconds() - start;
+    stats->token_count = token_count;
+    stats->input_bytes = stream.consumed + stream.tokeniser.index;
+  }
+  printf("Found %zu tokens, %zu lines, and %zu characters in %s\n",
+         token_count, token_stream_line_count(&stream), stream.consumed + stream.tokeniser.index, input_filename);
+
+  token_stream_free(&stream);
+  if (!from_stdin) fclose(f);
+  return 0;
+}
+
+int main(int argc, char **argv) {
   TokenArray token_array = {0};
 
+  char *program = sdm_shift_args(&argc, &argv);
   char *input_filename = "examples/small_example.ll";
-  // char *input_filename = "examples/example.ll";
-  // char *input_filename = "examples/type_example.ll";
+  LexerKind lexer = LEXER_LADDER;
+  bool zero_copy = false;
+  bool stream = false;
+  bool fused = false;
+  bool parse = false;
+  size_t thread_count = 1;
+  const char *cache_dir = NULL;
+  StatsFormat stats_format = STATS_NONE;
+  PipelineStats stats = {0};
+
+  while (argc > 0) {
+    char *arg = sdm_shift_args(&argc, &argv);
+    if (strcmp(arg, "--dfa") == 0) {
+      lexer = LEXER_DFA;
+    } else if (strcmp(arg, "--zero-copy") == 0) {
+      zero_copy = true;
+    } else if (strcmp(arg, "--stream") == 0) {
+      stream = true;
+    } else if (strcmp(arg, "--fused") == 0) {
+      fused = true;
+    } else if (strcmp(arg, "--parse") == 0) {
+      parse = true;
+    } else if (strcmp(arg, "--stats") == 0) {
+      stats_format = STATS_TABLE;
+    } else if (strcmp(arg, "--stats-json") == 0) {
+      stats_format = STATS_JSON;
+    } else if (strcmp(arg, "--threads") == 0) {
+      char *count = sdm_shift_args(&argc, &argv);
+      if (count == NULL || atoi(count) < 1) {
+        fprintf(stderr, "--threads needs a positive number\n");
+        usage(program);
+        return 1;
+      }
+      thread_count = atoi(count);
+    } else if (strcmp(arg, "--cache") == 0) {
+      cache_dir = sdm_shift_args(&argc, &argv);
+      if (cache_dir == NULL) {
+        fprintf(stderr, "--cache needs a directory\n");
+        usage(program);
+        return 1;
+      }
+    } else if (arg[0] == '-' && arg[1] != '\0') {
+      fprintf(stderr, "Unknown option: %s\n", arg);
+      usage(program);
+      return 1;
+    } else {
+      input_filename = arg;
+    }
+  }
+
+  // The fused pass is its own lexer, so it can't also stream, split the input or feed the parser
+  if (fused && (stream || thread_count > 1 || parse)) {
+    fprintf(stderr, "--fused can't be used with %s\n", stream ? "--stream" : parse ? "--parse" : "--threads");
+    usage(program);
+    return 1;
+  }
+
+  if (stream) {
+    int result = stream_input_file(input_filename, lexer, (stats_format != STATS_NONE) ? &stats : NULL);
+    if (result == 0 && stats_format != STATS_NONE) print_stats(&stats, stats_format);
+    app_arena_free();
+    return result;
+  }
 
-  char *buffer = sdm_read_entire_file(input_filename);
+  PHASE_BEGIN(stats, PHASE_READ);
+  sdm_string_view contents = sdm_map_entire_file(input_filename);
+  PHASE_END(stats, PHASE_READ);
+  stats.input_bytes = contents.length;
   Tokeniser tokeniser = {
     .filename = input_filename,
-    .contents = sdm_cstr_as_sv(buffer),
-    .col = 1,
-    .line = 1,
+    .contents = contents,
     .index = 0,
+    .lexer = lexer,
+    .zero_copy = zero_copy,
   };
 
-  tokenise_input_file(&tokeniser, &token_array);
-  find_and_apply_keywords(&token_array);
-  if (!validate_token_array(&token_array)) {
-    fprintf(stderr, "Invalid token array. This is a bug in the tokeniser.\n");
+  bool valid;
+  Ast ast = {0};
+  sdm_string_view cache_mapping = {0};
+  PHASE_BEGIN(stats, PHASE_CACHE_LOAD);
+  bool cached = cache_dir != NULL && token_cache_load(cache_dir, &tokeniser, &token_array, &cache_mapping);
+  PHASE_END(stats, PHASE_CACHE_LOAD);
+  if (fused && !cached) {
+    // Lexing and validation are one pass, so it all counts as tokenise
+    PHASE_BEGIN(stats, PHASE_TOKENISE);
+    valid = tokenise_and_validate(&tokeniser, &token_array);
+    PHASE_END(stats, PHASE_TOKENISE);
+  } else {
+    if (!cached) {
+      PHASE_BEGIN(stats, PHASE_TOKENISE);
+      stats.segment_arena_bytes = tokenise_input_file_parallel(&tokeniser, &token_array, thread_count);
+      PHASE_END(stats, PHASE_TOKENISE);
+    }
+    if (parse) {
+      // The grammar is not the validator's. The parser also accepts expression statements, like the
+      // println call in examples/example.ll, declarations with no value, and an empty input. It
+      // checks the expressions themselves, which the validator skips over.
+      PHASE_BEGIN(stats, PHASE_PARSE);
+      valid = parse_token_array(&token_array, &ast);
+      PHASE_END(stats, PHASE_PARSE);
+      stats.ast_nodes = ast.nodes.length;
+    } else {
+      PHASE_BEGIN(stats, PHASE_VALIDATE);
+      valid = validate_token_array(&token_array);
+      PHASE_END(stats, PHASE_VALIDATE);
+    }
+  }
+  // Only complete, valid token arrays are cached. The fused pass stops at the first error.
+  if (!cached && valid && cache_dir != NULL) {
+    PHASE_BEGIN(stats, PHASE_CACHE_STORE);
+    token_cache_store(cache_dir, &token_array);
+    PHASE_END(stats, PHASE_CACHE_STORE);
+  }
+  if (!valid) {
+    if (parse) {
+      print_parse_diagnostics(&ast);
+      fprintf(stderr, "Found %zu syntax error%s in %s\n", ast.diagnostics.length,
+              ast.diagnostics.length == 1 ? "" : "s", token_array.filename);
+    } else {
+      fprintf(stderr, "Invalid token array. This is a bug in the tokeniser.\n");
+    }
     return 1;
   };
 
-  print_token_array(token_array);
+  PHASE_BEGIN(stats, PHASE_PRINT);
+  if (parse) print_ast(&ast);
+  else print_token_array(&token_array);
   printf("Found %zu tokens, %zu lines, and %zu characters in %s\n", 
-         token_array.length, tokeniser.line, tokeniser.index, tokeniser.filename);
+         token_array.length, token_array_line_count(&token_array), tokeniser.index, tokeniser.filename);
+  PHASE_END(stats, PHASE_PRINT);
+
+  if (stats_format != STATS_NONE) {
+    fflush(stdout);
+    count_token_types(&stats, &token_array);
+    print_stats(&stats, stats_format);
+  }
 
-  sdm_arena_free(&main_arena);
+  if (cached) sdm_unmap_file(cache_mapping);
+  sdm_unmap_file(contents);
+  app_arena_free();
 
   return 0;
 }
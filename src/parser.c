@@ -0,0 +1,464 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "parser.h"
+
+static_assert(sizeof(AstNode) == 16, "AST nodes should pack into 16 bytes");
+static_assert(AST_KIND_COUNT <= UINT8_MAX, "AST kinds must fit in a byte");
+
+const char *AST_string[] = {
+  [AST_NONE]    = "AST_NONE",
+  [AST_PROGRAM] = "AST_PROGRAM",
+  [AST_LET]     = "AST_LET",
+  [AST_NAME]    = "AST_NAME",
+  [AST_INT]     = "AST_INT",
+  [AST_FLOAT]   = "AST_FLOAT",
+  [AST_STRING]  = "AST_STRING",
+  [AST_NEG]     = "AST_NEG",
+  [AST_ADD]     = "AST_ADD",
+  [AST_SUB]     = "AST_SUB",
+  [AST_MUL]     = "AST_MUL",
+  [AST_DIV]     = "AST_DIV",
+  [AST_CALL]    = "AST_CALL",
+  [AST_ARG]     = "AST_ARG",
+  [AST_FIELD]   = "AST_FIELD",
+};
+
+// How a token is described when it is not what was expected
+static const char *token_descriptions[TOKEN_TYPE_COUNT] = {
+  [TOKEN_TYPE_UNKNOWN]    = "an unknown character",
+  [TOKEN_TYPE_ID]         = "a name",
+  [TOKEN_TYPE_FLOAT]      = "a number",
+  [TOKEN_TYPE_INT]        = "a number",
+  [TOKEN_TYPE_STRING]     = "a string",
+  [TOKEN_TYPE_KEYWORD]    = "a keyword",
+  [TOKEN_TYPE_ASSIGNMENT] = "'='",
+  [TOKEN_TYPE_ADD]        = "'+'",
+  [TOKEN_TYPE_MULT]       = "'*'",
+  [TOKEN_TYPE_SUB]        = "'-'",
+  [TOKEN_TYPE_DIV]        = "'/'",
+  [TOKEN_TYPE_OPAREN]     = "'('",
+  [TOKEN_TYPE_CPAREN]     = "')'",
+  [TOKEN_TYPE_SEMICOLON]  = "';'",
+  [TOKEN_TYPE_COLON]      = "':'",
+  [TOKEN_TYPE_COMMA]      = "','",
+  [TOKEN_TYPE_POINT]      = "'.'",
+  [TOKEN_TYPE_EOF]        = "the end of the input",
+  [TOKEN_TYPE_QUOTEMARK]  = "'\"'",
+};
+
+// Binding powers. An infix operator takes the operand on its left if its power is at least the
+// minimum the caller asked for, and parses the operand on its right with a minimum one higher, so
+// operators of equal power associate to the left.
+enum {
+  BP_NONE = 0,
+  BP_SUM = 10,
+  BP_PRODUCT = 20,
+  BP_PREFIX = 30,
+};
+
+typedef struct {
+  const TokenArray *t_array;
+  Ast *ast;
+  size_t index;                // The next token
+  size_t depth;                // Of parse_expression calls
+  SDM_ARRAY(uint32_t) stack;   // Items of the lists still being parsed, innermost last. In the scratch arena.
+  bool panicking;              // An error was found and the rest of the statement is being skipped
+} Parser;
+
+static inline TokenType parser_peek_at(const Parser *p, size_t ahead) {
+  size_t i = p->index + ahead;
+  return (i < p->t_array->length) ? p->t_array->types[i] : TOKEN_TYPE_EOF;
+}
+
+static inline TokenType parser_peek(const Parser *p) {
+  return parser_peek_at(p, 0);
+}
+
+static sdm_string_view parser_symbol_string(const TokenArray *t_array, uint32_t symbol) {
+  const sdm_interner *symbols = t_array->symbols ? t_array->symbols : ll_symbol_table();
+  return sdm_interner_string(symbols, symbol);
+}
+
+// Records the current token as not being what was expected. Until the parser has resynchronised,
+// nothing more is recorded, since whatever follows the first error is likely to look wrong too.
+static void parser_error(Parser *p, const char *expected) {
+  if (p->panicking) return;
+  p->panicking = true;
+  const TokenArray *t_array = p->t_array;
+  ParseDiagnostic diagnostic = { .token = (uint32_t)p->index, .expected = expected };
+  // Input that doesn't end in trivia has no EOF token, so the end is reported at the last token
+  if (t_array->length > 0) {
+    size_t at = (p->index < t_array->length) ? p->index : t_array->length - 1;
+    diagnostic.loc = token_array_location(t_array, at);
+  }
+  SDM_ARRAY_PUSH(p->ast->diagnostics, diagnostic);
+}
+
+static inline bool parser_accept(Parser *p, TokenType type) {
+  if (parser_peek(p) != type) return false;
+  p->index++;
+  return true;
+}
+
+static inline bool parser_expect(Parser *p, TokenType type, const char *expected) {
+  if (parser_accept(p, type)) return true;
+  parser_error(p, expected);
+  return false;
+}
+
+static inline uint32_t parser_node(Parser *p, AstKind kind, size_t token, uint32_t lhs, uint32_t rhs) {
+  AstNode node = { .kind = kind, .token = (uint32_t)token, .lhs = lhs, .rhs = rhs };
+  SDM_ARRAY_PUSH(p->ast->nodes, node);
+  return p->ast->nodes.length - 1;
+}
+
+static void parser_push_item(Parser *p, uint32_t node) {
+  sdm_arena_t *previous = swap_active_arena(scratch_arena());
+  SDM_ARRAY_PUSH(p->stack, node);
+  swap_active_arena(previous);
+}
+
+// Moves the items pushed since start off the stack and into a list in extra
+static uint32_t parser_finish_list(Parser *p, size_t start) {
+  Ast *ast = p->ast;
+  uint32_t list = ast->extra.length;
+  uint32_t count = p->stack.length - start;
+  SDM_ARRAY_PUSH(ast->extra, count);
+  SDM_ARRAY_APPEND(ast->extra, &p->stack.data[start], count);
+  p->stack.length = start;
+  return list;
+}
+
+static uint32_t parse_expression(Parser *p, int min_bp);
+
+static uint32_t parse_prefix(Parser *p) {
+  const TokenArray *t_array = p->t_array;
+  size_t i = p->index;
+  switch (parser_peek(p)) {
+    case TOKEN_TYPE_ID: {
+      p->index++;
+      return parser_node(p, AST_NAME, i, t_array->payloads[i], 0);
+    }
+    case TOKEN_TYPE_INT: {
+      p->index++;
+      return parser_node(p, AST_INT, i, t_array->payloads[i], 0);
+    }
+    case TOKEN_TYPE_FLOAT: {
+      p->index++;
+      return parser_node(p, AST_FLOAT, i, t_array->payloads[i], 0);
+    }
+    case TOKEN_TYPE_STRING: {
+      p->index++;
+      return parser_node(p, AST_STRING, i, t_array->payloads[i], 0);
+    }
+    case TOKEN_TYPE_SUB: {
+      p->index++;
+      uint32_t operand = parse_expression(p, BP_PREFIX);
+      return parser_node(p, AST_NEG, i, operand, 0);
+    }
+    case TOKEN_TYPE_ADD: {
+      p->index++;
+      return parse_expression(p, BP_PREFIX);
+    }
+    case TOKEN_TYPE_OPAREN: {
+      p->index++;
+      uint32_t inner = parse_expression(p, BP_NONE);
+      parser_expect(p, TOKEN_TYPE_CPAREN, "')'");
+      return inner;
+    }
+    default: {
+      parser_error(p, "an expression");
+      return AST_NONE;
+    }
+  }
+}
+
+// After the '(' of a call: arguments separated by commas, each either `name = value` or a value
+static uint32_t parse_arguments(Parser *p) {
+  size_t start = p->stack.length;
+  if (parser_peek(p) != TOKEN_TYPE_CPAREN) {
+    do {
+      size_t i = p->index;
+      uint32_t arg;
+      if (parser_peek(p) == TOKEN_TYPE_ID && parser_peek_at(p, 1) == TOKEN_TYPE_ASSIGNMENT) {
+        p->index += 2;
+        uint32_t value = parse_expression(p, BP_NONE);
+        arg = parser_node(p, AST_ARG, i, p->t_array->payloads[i], value);
+      } else {
+        arg = parse_expression(p, BP_NONE);
+      }
+      parser_push_item(p, arg);
+    } while (!p->panicking && parser_accept(p, TOKEN_TYPE_COMMA));
+  }
+  if (!p->panicking) parser_expect(p, TOKEN_TYPE_CPAREN, "',' or ')'");
+  return parser_finish_list(p, start);
+}
+
+// Applies the operators that follow lhs, as long as they bind at least as tightly as min_bp
+static uint32_t parse_infix(Parser *p, uint32_t lhs, int min_bp) {
+  const TokenArray *t_array = p->t_array;
+  while (!p->panicking) {
+    size_t i = p->index;
+    TokenType type = parser_peek(p);
+    switch (type) {
+      case TOKEN_TYPE_ADD:
+      case TOKEN_TYPE_SUB:
+      case TOKEN_TYPE_MULT:
+      case TOKEN_TYPE_DIV: {
+        int bp = (type == TOKEN_TYPE_ADD || type == TOKEN_TYPE_SUB) ? BP_SUM : BP_PRODUCT;
+        if (bp < min_bp) return lhs;
+        p->index++;
+        uint32_t rhs = parse_expression(p, bp + 1);
+        AstKind kind = (type == TOKEN_TYPE_ADD) ? AST_ADD :
+                       (type == TOKEN_TYPE_SUB) ? AST_SUB :
+                       (type == TOKEN_TYPE_MULT) ? AST_MUL : AST_DIV;
+        lhs = parser_node(p, kind, i, lhs, rhs);
+      } break;
+      case TOKEN_TYPE_INT:
+      case TOKEN_TYPE_FLOAT: {
+        // The lexer reads `a -1` as a name and the number -1. Here the sign is really an operator,
+        // so it is parsed as a + (-1), with the signed number starting the right operand.
+        char sign = t_array->contents.data[token_array_offset(t_array, i)];
+        if ((sign != '-' && sign != '+') || BP_SUM < min_bp) return lhs;
+        uint32_t rhs = parse_expression(p, BP_SUM + 1);
+        lhs = parser_node(p, AST_ADD, i, lhs, rhs);
+      } break;
+      case TOKEN_TYPE_OPAREN: {
+        p->index++;
+        uint32_t args = parse_arguments(p);
+        lhs = parser_node(p, AST_CALL, i, lhs, args);
+      } break;
+      case TOKEN_TYPE_POINT: {
+        p->index++;
+        size_t field = p->index;
+        if (!parser_expect(p, TOKEN_TYPE_ID, "a field name")) return AST_NONE;
+        lhs = parser_node(p, AST_FIELD, i, lhs, t_array->payloads[field]);
+      } break;
+      default: return lhs;
+    }
+  }
+  return AST_NONE;
+}
+
+static uint32_t parse_expression(Parser *p, int min_bp) {
+  if (p->depth >= PARSER_MAX_DEPTH) {
+    parser_error(p, "a less deeply nested expression");
+    return AST_NONE;
+  }
+  p->depth++;
+  uint32_t lhs = parse_infix(p, parse_prefix(p), min_bp);
+  p->depth--;
+  return lhs;
+}
+
+// let name: type = value
+static uint32_t parse_let(Parser *p) {
+  p->index++;
+  size_t name = p->index;
+  if (!parser_expect(p, TOKEN_TYPE_ID, "a name after 'let'")) return AST_NONE;
+  if (!parser_expect(p, TOKEN_TYPE_COLON, "':'")) return AST_NONE;
+  size_t type = p->index;
+  if (!parser_expect(p, TOKEN_TYPE_ID, "a type")) return AST_NONE;
+  uint32_t value = AST_NONE;
+  if (parser_accept(p, TOKEN_TYPE_ASSIGNMENT)) value = parse_expression(p, BP_NONE);
+  else if (parser_peek(p) != TOKEN_TYPE_SEMICOLON) parser_error(p, "'=' or ';'");
+  return parser_node(p, AST_LET, name, p->t_array->payloads[type], value);
+}
+
+// Skips the rest of a statement with an error: up to and including the next ';', or up to the next
+// 'let', which most likely starts a statement
+static void parser_synchronise(Parser *p) {
+  const TokenArray *t_array = p->t_array;
+  for (TokenType type = parser_peek(p); type != TOKEN_TYPE_EOF; type = parser_peek(p)) {
+    if (type == TOKEN_TYPE_KEYWORD && t_array->payloads[p->index] == KEYWORD_LET) break;
+    p->index++;
+    if (type == TOKEN_TYPE_SEMICOLON) break;
+  }
+  p->panicking = false;
+}
+
+static void parse_program(Parser *p) {
+  const TokenArray *t_array = p->t_array;
+  size_t start = p->stack.length;
+  while (parser_peek(p) != TOKEN_TYPE_EOF) {
+    if (parser_accept(p, TOKEN_TYPE_SEMICOLON)) continue;
+    uint32_t statement;
+    if (parser_peek(p) == TOKEN_TYPE_KEYWORD && t_array->payloads[p->index] == KEYWORD_LET) {
+      statement = parse_let(p);
+    } else {
+      statement = parse_expression(p, BP_NONE);
+    }
+    if (!p->panicking && parser_expect(p, TOKEN_TYPE_SEMICOLON, "';'")) parser_push_item(p, statement);
+    // Every path to an error consumes at least one token or stops at the end, so this always
+    // makes progress
+    if (p->panicking) parser_synchronise(p);
+  }
+  uint32_t list = parser_finish_list(p, start);
+  p->ast->root = parser_node(p, AST_PROGRAM, p->index, list, 0);
+}
+
+bool parse_token_array(const TokenArray *t_array, Ast *ast) {
+  ast->t_array = t_array;
+  // A token makes at most one node, except for a signed number used as an operator, so this is
+  // nearly always the only allocation the nodes need. Node 0 is the unused "none".
+  SDM_ARRAY_RESERVE(ast->nodes, t_array->length + 2);
+  if (ast->nodes.length == 0) SDM_ARRAY_PUSH(ast->nodes, (AstNode){0});
+
+  // The list stack is only needed while parsing
+  sdm_arena_t *scratch = scratch_arena();
+  sdm_arena_mark mark = sdm_arena_get_mark(scratch);
+  Parser parser = { .t_array = t_array, .ast = ast };
+  parse_program(&parser);
+  sdm_arena_rewind(scratch, mark);
+  return ast->diagnostics.length == 0;
+}
+
+void print_parse_diagnostics(const Ast *ast) {
+  const TokenArray *t_array = ast->t_array;
+  for (size_t d=0; d<ast->diagnostics.length; d++) {
+    const ParseDiagnostic *diagnostic = &ast->diagnostics.data[d];
+    if (t_array->length == 0) {
+      fprintf(stderr, "%s: ERROR: expected %s, found the end of the input\n", t_array->filename, diagnostic->expected);
+      continue;
+    }
+    fprintf(stderr, "%s:%zu:%zu: ERROR: expected %s, found ", t_array->filename,
+            diagnostic->loc.line, diagnostic->loc.col, diagnostic->expected);
+    size_t i = diagnostic->token;
+    TokenType type = (i < t_array->length) ? t_array->types[i] : TOKEN_TYPE_EOF;
+    if (type == TOKEN_TYPE_ID) {
+      fprintf(stderr, "'"SDM_SV_F"'\n", SDM_SV_Vals(parser_symbol_string(t_array, t_array->payloads[i])));
+    } else if (type == TOKEN_TYPE_KEYWORD) {
+      fprintf(stderr, "'%s'\n", keyword_strings[t_array->payloads[i]]);
+    } else {
+      fprintf(stderr, "%s\n", token_descriptions[type]);
+    }
+  }
+}
+
+// Operators, calls and field accesses print their left operand first, and chains of them like
+// a + b + c nest to the left as deep as they are long. So each is printed in two halves, around its
+// left operand, and a chain is walked with a loop rather than by recursion.
+static bool ast_is_left_chained(AstKind kind) {
+  return kind == AST_ADD || kind == AST_SUB || kind == AST_MUL || kind == AST_DIV ||
+         kind == AST_CALL || kind == AST_FIELD;
+}
+
+static void print_ast_node(const Ast *ast, uint32_t n);
+
+static void print_ast_open(const AstNode *node) {
+  switch ((AstKind)node->kind) {
+    case AST_ADD: printf("(+ "); break;
+    case AST_SUB: printf("(- "); break;
+    case AST_MUL: printf("(* "); break;
+    case AST_DIV: printf("(/ "); break;
+    case AST_CALL: printf("("); break;
+    case AST_FIELD: printf("(. "); break;
+    default: break;
+  }
+}
+
+static void print_ast_close(const Ast *ast, const AstNode *node) {
+  switch ((AstKind)node->kind) {
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV: {
+      printf(" ");
+      print_ast_node(ast, node->rhs);
+      printf(")");
+    } break;
+    case AST_CALL: {
+      uint32_t count = ast_list_length(ast, node->rhs);
+      const uint32_t *args = ast_list_items(ast, node->rhs);
+      for (uint32_t a=0; a<count; a++) {
+        printf(" ");
+        print_ast_node(ast, args[a]);
+      }
+      printf(")");
+    } break;
+    case AST_FIELD: {
+      printf(" "SDM_SV_F")", SDM_SV_Vals(parser_symbol_string(ast->t_array, node->rhs)));
+    } break;
+    default: break;
+  }
+}
+
+static void print_ast_node(const Ast *ast, uint32_t n) {
+  const TokenArray *t_array = ast->t_array;
+  const AstNode *node = &ast->nodes.data[n];
+  if (ast_is_left_chained((AstKind)node->kind)) {
+    sdm_arena_t *scratch = scratch_arena();
+    sdm_arena_mark mark = sdm_arena_get_mark(scratch);
+    SDM_ARRAY(uint32_t) chain = {0};
+    sdm_arena_t *previous = swap_active_arena(scratch);
+    while (ast_is_left_chained((AstKind)ast->nodes.data[n].kind)) {
+      SDM_ARRAY_PUSH(chain, n);
+      n = ast->nodes.data[n].lhs;
+    }
+    swap_active_arena(previous);
+    for (size_t c=0; c<chain.length; c++) print_ast_open(&ast->nodes.data[chain.data[c]]);
+    print_ast_node(ast, n);
+    for (size_t c=chain.length; c-- > 0;) print_ast_close(ast, &ast->nodes.data[chain.data[c]]);
+    sdm_arena_rewind(scratch, mark);
+    return;
+  }
+  switch ((AstKind)node->kind) {
+    case AST_LET: {
+      sdm_string_view name = parser_symbol_string(t_array, t_array->payloads[node->token]);
+      sdm_string_view type = parser_symbol_string(t_array, node->lhs);
+      printf("(let "SDM_SV_F" "SDM_SV_F, SDM_SV_Vals(name), SDM_SV_Vals(type));
+      if (node->rhs != AST_NONE) {
+        printf(" ");
+        print_ast_node(ast, node->rhs);
+      }
+      printf(")");
+    } break;
+    case AST_NAME: {
+      printf(SDM_SV_F, SDM_SV_Vals(parser_symbol_string(t_array, node->lhs)));
+    } break;
+    case AST_INT: {
+      printf("%ld", t_array->ints.data[node->lhs]);
+    } break;
+    case AST_FLOAT: {
+      // Enough digits to read back as the same double, and a point or exponent, so a float never
+      // prints like an int
+      char text[32];
+      snprintf(text, sizeof(text), "%.17g", t_array->floats.data[node->lhs]);
+      printf("%s%s", text, strpbrk(text, ".eni") ? "" : ".0");
+    } break;
+    case AST_STRING: {
+      printf("\""SDM_SV_F"\"", SDM_SV_Vals(t_array->strings.data[node->lhs]));
+    } break;
+    case AST_NEG: {
+      printf("(- ");
+      print_ast_node(ast, node->lhs);
+      printf(")");
+    } break;
+    case AST_ARG: {
+      printf("(= "SDM_SV_F" ", SDM_SV_Vals(parser_symbol_string(t_array, node->lhs)));
+      print_ast_node(ast, node->rhs);
+      printf(")");
+    } break;
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_CALL:
+    case AST_FIELD:
+    case AST_NONE:
+    case AST_PROGRAM:
+    case AST_KIND_COUNT: break;
+  }
+}
+
+void print_ast(const Ast *ast) {
+  const AstNode *root = &ast->nodes.data[ast->root];
+  uint32_t count = ast_list_length(ast, root->lhs);
+  const uint32_t *statements = ast_list_items(ast, root->lhs);
+  for (uint32_t s=0; s<count; s++) {
+    print_ast_node(ast, statements[s]);
+    printf("\n");
+  }
+}
@@ -0,0 +1,79 @@
+#ifndef _PARSER_H
+#define _PARSER_H
+
+#include "token_lib.h"
+
+// The syntax tree is one flat array of nodes. Children are referred to by their 32-bit index in the
+// array rather than by pointer, so a node is 16 bytes and a whole tree is a single allocation. Index
+// 0 is never a real node, so it stands for "none". A node with a variable number of children (the
+// statements of the program, the arguments of a call) has a list in extra: the count, followed by
+// that many node indices.
+typedef enum {
+  AST_NONE = 0,
+  AST_PROGRAM,  // lhs: the list of statements
+  AST_LET,      // token: the name. lhs: the symbol of the type. rhs: the value, or AST_NONE
+  AST_NAME,     // lhs: the symbol
+  AST_INT,      // lhs: the index of the value in the token array's ints
+  AST_FLOAT,    // lhs: the index of the value in the token array's floats
+  AST_STRING,   // lhs: the index of the value in the token array's strings
+  AST_NEG,      // lhs: the operand
+  AST_ADD,      // lhs, rhs: the operands
+  AST_SUB,
+  AST_MUL,
+  AST_DIV,
+  AST_CALL,     // lhs: the function. rhs: the list of arguments
+  AST_ARG,      // A named argument, `name = value`. token: the name. lhs: its symbol. rhs: the value
+  AST_FIELD,    // lhs: the object. rhs: the symbol of the field
+  AST_KIND_COUNT,
+} AstKind;
+
+extern const char *AST_string[];
+
+typedef struct {
+  uint8_t kind;
+  uint32_t token;  // The token the node was made from, for diagnostics. For operators, the operator.
+  uint32_t lhs;
+  uint32_t rhs;
+} AstNode;
+
+// A syntax error. The token is where it was found, and may be one past the last token if the input
+// ended early. The location is the token's, or the last token's at the end of the input.
+typedef struct {
+  uint32_t token;
+  TokenLocation loc;
+  const char *expected;  // What the parser was looking for, e.g. "';'" or "an expression"
+} ParseDiagnostic;
+
+typedef struct {
+  const TokenArray *t_array;  // The tokens the nodes refer to. It has to outlive the tree.
+  SDM_ARRAY(AstNode) nodes;
+  SDM_ARRAY(uint32_t) extra;
+  uint32_t root;              // The AST_PROGRAM node
+  SDM_ARRAY(ParseDiagnostic) diagnostics;
+} Ast;
+
+// Parentheses, calls and prefix signs nest by recursion, so the nesting is capped to keep the C stack
+// from overflowing. Operator chains like a + b + c are parsed in a loop and aren't limited.
+#define PARSER_MAX_DEPTH 1000
+
+// Parses a whole token array. A program is a list of statements, each ended by ';': either
+// `let name: type`, optionally followed by `= expression`, or an expression on its own, such as a
+// call. validate_token_array differs: it only accepts lets with a value, and doesn't check what is
+// inside the expressions.
+//
+// After a syntax error the parser skips to the next ';' or 'let' and carries on, so one pass finds
+// every error. The statements with errors are left out of the tree. Returns false if there were any
+// errors, which are in ast->diagnostics.
+bool parse_token_array(const TokenArray *t_array, Ast *ast);
+
+// Prints each diagnostic to stderr as "file:line:col: ERROR: expected ..., found ..."
+void print_parse_diagnostics(const Ast *ast);
+
+// The children in the list that starts at extra[list]
+static inline uint32_t ast_list_length(const Ast *ast, uint32_t list) { return ast->extra.data[list]; }
+static inline const uint32_t *ast_list_items(const Ast *ast, uint32_t list) { return &ast->extra.data[list + 1]; }
+
+// Prints each statement on its own line as an S-expression, e.g. (let x int (+ 5 (* 2 7)))
+void print_ast(const Ast *ast);
+
+#endif // _PARSER_H
@@ -1,13 +1,32 @@
+// For MAP_ANONYMOUS and sysconf when building with -std=c18
+#define _DEFAULT_SOURCE
+
 #include <ctype.h>
 #include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define SDM_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "sdm_lib.h"
 
 char *sdm_read_entire_file(const char *file_path) {
   // Reads an entire file into a char array, and returns a ptr to this. The ptr should be freed by the caller
+  // The contents are NUL-terminated
   FILE *f = fopen(file_path, "r");
   if (f==NULL) {
     fprintf(stderr, "Could not read %s: %s\n", file_path, strerror(errno));
@@ -15,7 +34,12 @@ char *sdm_read_entire_file(const char *file_path) {
   }
 
   fseek(f, 0L, SEEK_END);
-  int sz = ftell(f);
+  long end = ftell(f);
+  if (end < 0) {
+    fprintf(stderr, "Could not read %s: %s\n", file_path, strerror(errno));
+    exit(1);
+  }
+  size_t sz = (size_t)end;
   fseek(f, 0L, SEEK_SET);
 
   char *contents = SDM_MALLOC((sz + 1) * sizeof(char));
@@ -23,13 +47,94 @@ char *sdm_read_entire_file(const char *file_path) {
     fprintf(stderr, "Could not allocate memory. Buy more RAM I guess?\n");
     exit(1);
   }
-  fread(contents, 1, sz, f);
+  size_t read = fread(contents, 1, sz, f);
+  if (read != sz && ferror(f)) {
+    fprintf(stderr, "Could not read %s: %s\n", file_path, strerror(errno));
+    exit(1);
+  }
+  contents[read] = '\0';
 
   fclose(f);
   
   return contents;
 }
 
+#ifdef SDM_HAVE_MMAP
+static size_t sdm_page_size(void) {
+  long page = sysconf(_SC_PAGESIZE);
+  return page > 0 ? (size_t)page : 4096;
+}
+
+// The file pages, rounded up to a whole page, followed by one page of padding
+static size_t sdm_mapping_size(size_t length) {
+  size_t page = sdm_page_size();
+  return ((length + page - 1) / page) * page + page;
+}
+#endif
+
+bool sdm_try_map_file(const char *file_path, sdm_string_view *contents) {
+#ifdef SDM_HAVE_MMAP
+  int fd = open(file_path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return false;
+  }
+  size_t length = (size_t)st.st_size;
+
+  // Reserve the whole range as zeroed anonymous memory first, then map the file over the front of
+  // it. Whatever follows the file (the tail of its last page and the padding page) reads as zero.
+  size_t mapping_size = sdm_mapping_size(length);
+  char *base = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return false;
+  }
+  if (length > 0) {
+    void *file_map = mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (file_map == MAP_FAILED) {
+      int saved = errno;
+      munmap(base, mapping_size);
+      close(fd);
+      errno = saved;
+      return false;
+    }
+  }
+  close(fd);
+
+  *contents = sdm_sized_str_as_sv(base, length);
+  return true;
+#else
+  FILE *f = fopen(file_path, "r");
+  if (f == NULL) return false;
+  fclose(f);
+  *contents = sdm_cstr_as_sv(sdm_read_entire_file(file_path));
+  return true;
+#endif
+}
+
+sdm_string_view sdm_map_entire_file(const char *file_path) {
+  sdm_string_view contents;
+  if (!sdm_try_map_file(file_path, &contents)) {
+    fprintf(stderr, "Could not read %s: %s\n", file_path, strerror(errno));
+    exit(1);
+  }
+  return contents;
+}
+
+void sdm_unmap_file(sdm_string_view contents) {
+#ifdef SDM_HAVE_MMAP
+  munmap(contents.data, sdm_mapping_size(contents.length));
+#else
+  (void)contents;
+#endif
+}
+
 sdm_string_view sdm_cstr_as_sv(char *cstr) {
   return (sdm_string_view){
     .data = cstr,
@@ -127,108 +232,363 @@ char *sdm_shift_args(int *argc, char ***argv) {
   return *ret;
 }
 
-uint32_t get_hashmap_location(const char* key, size_t capacity) {
-  uint32_t key_hash = hash((uint8_t*)key, strlen(key));
-  return key_hash % capacity;
+void *sdm_array_grow(void *data, size_t *capacity, size_t length, size_t item_size, size_t min_capacity,
+                     void *small, size_t small_capacity) {
+  if (data == NULL && small != NULL && min_capacity <= small_capacity) {
+    *capacity = small_capacity;
+    return small;
+  }
+  size_t new_capacity = (*capacity > 0) ? *capacity : DEFAULT_CAPACITY;
+  if (*capacity == 0 && min_capacity > new_capacity) new_capacity = min_capacity;
+  while (new_capacity < min_capacity) new_capacity *= 2;
+
+  void *grown;
+  if (data != NULL && data == small) {
+    grown = SDM_MALLOC(new_capacity * item_size);
+    if (grown != NULL) memcpy(grown, data, length * item_size);
+  } else {
+    grown = SDM_REALLOC(data, length * item_size, new_capacity * item_size);
+  }
+  if (grown == NULL) {
+    fprintf(stderr, "ERR: Couldn't alloc memory.\n");
+    exit(1);
+  }
+  *capacity = new_capacity;
+  return grown;
 }
 
-void resize_dblarray(DblArray *hm) {
-  DblArray resized_array = {0};
-  SET_HM_CAPACITY((&resized_array), hm->capacity * 2);
-  for (size_t i=0; i<hm->capacity; i++) {
-    if (!hm->data[i].occupied) continue;
-    push_to_dblarray(&resized_array, hm->data[i].key, hm->data[i].value);
-  }
-  hm->capacity = resized_array.capacity;
-  SDM_FREE(hm->data);
-  hm->data = resized_array.data;
+#define SDM_INTERNER_DEFAULT_SLOTS 256
+
+// Bit i is set if control byte i of the group equals byte
+static inline uint32_t sdm_interner_match(const uint8_t *group, uint8_t byte) {
+#if defined(__SSE2__)
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+#else
+  uint32_t mask = 0;
+  for (int i=0; i<SDM_INTERNER_GROUP; i++) mask |= (uint32_t)(group[i] == byte) << i;
+  return mask;
+#endif
 }
 
-void push_to_dblarray(DblArray *hm, char *key, double value) {
-  if (hm->length >= hm->capacity) resize_dblarray(hm);
-  PUSH_TO_HASHMAP(hm, key, value);
+// The hash is split in two: the bits above the low 7 pick the group to start probing from, and the
+// low 7 go in the control byte. Groups are probed in triangular steps, which visits every group
+// when there is a power of two of them. Returns the slot of str with *found set, or else the empty
+// slot where it would go. Nothing is ever removed, so str would be in the first empty slot on its path.
+static size_t sdm_interner_probe(const sdm_interner *interner, sdm_string_view str, uint32_t h, bool *found) {
+  size_t group_mask = interner->slot_capacity / SDM_INTERNER_GROUP - 1;
+  size_t g = (h >> 7) & group_mask;
+  for (size_t step=1; ; step++) {
+    const uint8_t *group = &interner->ctrl[g * SDM_INTERNER_GROUP];
+    uint32_t candidates = sdm_interner_match(group, h & 0x7F);
+    while (candidates) {
+      size_t i = g * SDM_INTERNER_GROUP + __builtin_ctz(candidates);
+      uint32_t symbol = interner->slots[i];
+      if (interner->hashes.data[symbol] == h && sdm_sv_compare(interner->strings.data[symbol], str)) {
+        *found = true;
+        return i;
+      }
+      candidates &= candidates - 1;
+    }
+    uint32_t empty = sdm_interner_match(group, SDM_INTERNER_EMPTY);
+    if (empty) {
+      *found = false;
+      return g * SDM_INTERNER_GROUP + __builtin_ctz(empty);
+    }
+    g = (g + step) & group_mask;
+  }
 }
 
-// https://en.wikipedia.org/wiki/Jenkins_hash_function
-uint32_t jenkins_one_at_a_time_hash(const uint8_t* key, size_t length) {
-  size_t i = 0;
-  uint32_t hash = 0;
-  while (i != length) {
-    hash += key[i++];
-    hash += hash << 10;
-    hash ^= hash >> 6;
+// The strings are all different, so each one only needs the first empty slot on its path
+static void sdm_interner_insert_slot(sdm_interner *interner, uint32_t h, uint32_t symbol) {
+  size_t group_mask = interner->slot_capacity / SDM_INTERNER_GROUP - 1;
+  size_t g = (h >> 7) & group_mask;
+  uint32_t empty;
+  for (size_t step=1; !(empty = sdm_interner_match(&interner->ctrl[g * SDM_INTERNER_GROUP], SDM_INTERNER_EMPTY)); step++) {
+    g = (g + step) & group_mask;
   }
-  hash += hash << 3;
-  hash ^= hash >> 11;
-  hash += hash << 15;
-  return hash;
+  size_t i = g * SDM_INTERNER_GROUP + __builtin_ctz(empty);
+  interner->ctrl[i] = h & 0x7F;
+  interner->slots[i] = symbol;
 }
 
-void sdm_arena_init(sdm_arena_t *arena, size_t capacity) {
-  arena->start = malloc(capacity);
-  if (arena->start == NULL) {
-    fprintf(stderr, "Memory problem. Aborting.\n");
+static void sdm_interner_grow(sdm_interner *interner) {
+  interner->slot_capacity = interner->slot_capacity ? interner->slot_capacity * 2 : SDM_INTERNER_DEFAULT_SLOTS;
+  interner->ctrl = SDM_MALLOC(interner->slot_capacity);
+  interner->slots = SDM_MALLOC(interner->slot_capacity * sizeof(interner->slots[0]));
+  if (interner->ctrl == NULL || interner->slots == NULL) {
+    fprintf(stderr, "ERR: Couldn't alloc memory.\n");
     exit(1);
   }
-  memset(arena->start, 0, capacity);
-  arena->next = malloc(sizeof(*arena->next));
-  if (arena->next == NULL) {
+  memset(interner->ctrl, SDM_INTERNER_EMPTY, interner->slot_capacity);
+  for (size_t i=0; i<interner->strings.length; i++) {
+    sdm_interner_insert_slot(interner, interner->hashes.data[i], i);
+  }
+}
+
+uint32_t sdm_intern(sdm_interner *interner, sdm_string_view str) {
+  return sdm_intern_hashed(interner, str, sdm_hash_bytes(str.data, str.length));
+}
+
+bool sdm_interner_find(const sdm_interner *interner, sdm_string_view str, uint32_t *symbol) {
+  if (interner->slot_capacity == 0) return false;
+  bool found;
+  size_t slot = sdm_interner_probe(interner, str, sdm_hash_bytes(str.data, str.length), &found);
+  if (found) *symbol = interner->slots[slot];
+  return found;
+}
+
+uint32_t sdm_intern_hashed(sdm_interner *interner, sdm_string_view str, uint32_t h) {
+  // Grow before the table is 7/8 full. Past that, lookups would start to run over several groups.
+  if (8 * (interner->strings.length + 1) > 7 * interner->slot_capacity) sdm_interner_grow(interner);
+
+  bool found;
+  size_t slot = sdm_interner_probe(interner, str, h, &found);
+  if (found) return interner->slots[slot];
+
+  uint32_t symbol = interner->strings.length;
+  sdm_string_view copy = sdm_sized_str_as_sv(sdm_sv_to_cstr(str), str.length);
+  SDM_ARRAY_PUSH(interner->strings, copy);
+  SDM_ARRAY_PUSH(interner->hashes, h);
+  interner->ctrl[slot] = h & 0x7F;
+  interner->slots[slot] = symbol;
+  return symbol;
+}
+
+uint32_t sdm_interner_hash(const sdm_interner *interner, uint32_t symbol) {
+  return interner->hashes.data[symbol];
+}
+
+sdm_string_view sdm_interner_string(const sdm_interner *interner, uint32_t symbol) {
+  return interner->strings.data[symbol];
+}
+
+// In the style of wyhash: 16 bytes at a time (48 on long inputs, in three independent lanes) are
+// folded in with a 64x64->128-bit multiply, whose two halves are xored together. Inputs of up to
+// 16 bytes, like most identifiers, are read with at most four overlapping loads and no loop. Not
+// cryptographic. It only needs to make accidental collisions unlikely.
+
+#define SDM_HASH_S0 0x2d358dccaa6c78a5ull
+#define SDM_HASH_S1 0x8bb84b93962eacc9ull
+#define SDM_HASH_S2 0x4b33a62ed433d4a3ull
+#define SDM_HASH_S3 0x4d5a2da51de1aa47ull
+
+static inline uint64_t sdm_hash_mix(uint64_t a, uint64_t b) {
+  uint64_t hi, lo;
+  sdm_mul_64x64(a, b, &hi, &lo);
+  return lo ^ hi;
+}
+
+static inline uint64_t sdm_hash_read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t sdm_hash_read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint64_t sdm_hash_bytes(const void *data, size_t length) {
+  return sdm_hash_bytes_salted(data, length, 0);
+}
+
+uint64_t sdm_hash_bytes_salted(const void *data, size_t length, uint64_t salt) {
+  const uint8_t *p = data;
+  uint64_t seed = sdm_hash_mix(SDM_HASH_S0 ^ salt, SDM_HASH_S1);
+  uint64_t a = 0, b = 0;
+  if (length <= 16) {
+    if (length >= 4) {
+      // Two 8-byte words made of four 4-byte loads, which overlap when length < 16
+      size_t middle = (length >> 3) << 2;
+      a = (sdm_hash_read32(p) << 32) | sdm_hash_read32(p + middle);
+      b = (sdm_hash_read32(p + length - 4) << 32) | sdm_hash_read32(p + length - 4 - middle);
+    } else if (length > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[length >> 1] << 8) | p[length - 1];
+    }
+  } else {
+    size_t i = length;
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = sdm_hash_mix(sdm_hash_read64(p) ^ SDM_HASH_S1, sdm_hash_read64(p + 8) ^ seed);
+        see1 = sdm_hash_mix(sdm_hash_read64(p + 16) ^ SDM_HASH_S2, sdm_hash_read64(p + 24) ^ see1);
+        see2 = sdm_hash_mix(sdm_hash_read64(p + 32) ^ SDM_HASH_S3, sdm_hash_read64(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = sdm_hash_mix(sdm_hash_read64(p) ^ SDM_HASH_S1, sdm_hash_read64(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    // The last 16 bytes, which may overlap ones already mixed in
+    a = sdm_hash_read64(p + i - 16);
+    b = sdm_hash_read64(p + i - 8);
+  }
+  uint64_t hi, lo;
+  sdm_mul_64x64(a ^ SDM_HASH_S1, b ^ seed, &hi, &lo);
+  return sdm_hash_mix(lo ^ SDM_HASH_S0 ^ length, hi ^ SDM_HASH_S1);
+}
+
+// Chunks are reserved address space: pages are only backed by memory (already zeroed) when they are
+// first written to, so a large chunk costs nothing up front
+void sdm_arena_init(sdm_arena_t *arena, size_t capacity) {
+#ifdef SDM_HAVE_MMAP
+  size_t page = sdm_page_size();
+  capacity = ((capacity + page - 1) / page) * page;
+  void *start = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (start == MAP_FAILED) start = NULL;
+#if defined(SDM_ARENA_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+  // Fewer TLB misses on big inputs, at the cost of faulting in 2 MB at a time
+  if (start != NULL) madvise(start, capacity, MADV_HUGEPAGE);
+#endif
+#else
+  void *start = malloc(capacity);
+#endif
+  if (start == NULL) {
     fprintf(stderr, "Memory problem. Aborting.\n");
     exit(1);
   }
-  memset(arena->next, 0, sizeof(*arena->next));
+  arena->start = start;
   arena->capacity = capacity;
   arena->length = 0;
+  arena->last = 0;
   arena->alignment = sizeof(void*);
 }
 
-void *sdm_arena_alloc(sdm_arena_t *arena, size_t size) {
-  if (arena->start == NULL) {
-    size_t capacity = (arena->capacity > 0) ? arena->capacity : SDM_ARENA_DEFAULT_CAP;
-    while (capacity < size) {
-      capacity *= 2;
-    }
-    sdm_arena_init(arena, capacity);
-  }
+// The chunk allocations currently come from. Earlier chunks are full, or were when it was added.
+static sdm_arena_t *sdm_arena_current(sdm_arena_t *arena) {
+  return (arena->current != NULL) ? arena->current : arena;
+}
 
-  if (arena->capacity - arena->length < size) {
-    if (arena->next->capacity == 0) arena->next->capacity = arena->capacity;
-    return sdm_arena_alloc(arena->next, size);
-  }
+static size_t sdm_arena_aligned_length(const sdm_arena_t *chunk) {
+  size_t a = chunk->length % chunk->alignment;
+  return (a != 0) ? chunk->length + chunk->alignment - a : chunk->length;
+}
 
-  uintptr_t rel_offset = arena->length;
-  size_t a = (uintptr_t)rel_offset % arena->alignment;
-  size_t align_shift = 0;
-  if (a != 0) {
-    align_shift = arena->alignment - a;
-    rel_offset += align_shift;
+// The alignment padding has to fit as well, or the allocation would run off the end of the chunk
+static bool sdm_arena_fits(const sdm_arena_t *chunk, size_t size) {
+  size_t offset = sdm_arena_aligned_length(chunk);
+  return offset <= chunk->capacity && chunk->capacity - offset >= size;
+}
+
+static void sdm_arena_init_for(sdm_arena_t *chunk, size_t size) {
+  size_t capacity = (chunk->capacity > 0) ? chunk->capacity : SDM_ARENA_DEFAULT_CAP;
+  while (capacity < size) {
+    capacity *= 2;
   }
+  sdm_arena_init(chunk, capacity);
+}
 
-  if (size > 0)
-    arena->length += size + align_shift;
-  else
-    arena->length += 1;
+// Moves the arena on to the chunk after the current one, reusing a chunk left over from a rewind
+// if there is one. Each chunk is twice the size of the one before, so a growing arena needs few.
+static sdm_arena_t *sdm_arena_next_chunk(sdm_arena_t *arena, sdm_arena_t *chunk, size_t size) {
+  if (chunk->next == NULL) {
+    chunk->next = calloc(1, sizeof(*chunk->next));
+    if (chunk->next == NULL) {
+      fprintf(stderr, "Memory problem. Aborting.\n");
+      exit(1);
+    }
+    chunk->next->capacity = 2 * chunk->capacity;
+  }
+  chunk = chunk->next;
+  if (chunk->start == NULL) sdm_arena_init_for(chunk, size);
+  arena->current = chunk;
+  return chunk;
+}
 
-  return &arena->start[rel_offset];
+void *sdm_arena_alloc(sdm_arena_t *arena, size_t size) {
+  sdm_arena_t *chunk = sdm_arena_current(arena);
+  if (chunk->start == NULL) sdm_arena_init_for(chunk, size);
+  // A chunk left over from a rewind can be too small, in which case it is skipped
+  while (!sdm_arena_fits(chunk, size)) chunk = sdm_arena_next_chunk(arena, chunk, size);
+
+  size_t offset = sdm_arena_aligned_length(chunk);
+  chunk->length = offset + ((size > 0) ? size : 1);
+  chunk->last = offset;
+  return &chunk->start[offset];
 }
 
-void *sdm_arena_realloc(sdm_arena_t *arena, void *ptr, size_t size) {
+void *sdm_arena_realloc(sdm_arena_t *arena, void *ptr, size_t old_size, size_t size) {
+  if (ptr == NULL) return sdm_arena_alloc(arena, size);
+
+  // Nothing follows the last allocation, so it can grow (or shrink) where it is
+  sdm_arena_t *chunk = sdm_arena_current(arena);
+  if (chunk->start != NULL && (unsigned char*)ptr == chunk->start + chunk->last && chunk->capacity - chunk->last >= size) {
+    chunk->length = chunk->last + ((size > 0) ? size : 1);
+    return ptr;
+  }
+
   void *retval = sdm_arena_alloc(arena, size);
-  if (ptr) memcpy(retval, ptr, size);
+  memcpy(retval, ptr, old_size < size ? old_size : size);
   return retval;
 }
 
+static void sdm_arena_release(sdm_arena_t *chunk) {
+  if (chunk->start == NULL) return;
+#ifdef SDM_HAVE_MMAP
+  munmap(chunk->start, chunk->capacity);
+#else
+  free(chunk->start);
+#endif
+  chunk->start = NULL;
+}
+
 void sdm_arena_free(sdm_arena_t *arena) {
-  if (arena->next) {
-    sdm_arena_free(arena->next);
+  sdm_arena_t *chunk = arena->next;
+  while (chunk != NULL) {
+    sdm_arena_t *next = chunk->next;
+    sdm_arena_release(chunk);
+    free(chunk);
+    chunk = next;
   }
-
-  SDM_FREE_AND_NULL(arena->start);
+  sdm_arena_release(arena);
 
   arena->length = 0;
   arena->capacity = 0;
+  arena->last = 0;
+  arena->next = NULL;
+  arena->current = NULL;
+}
+
+size_t sdm_arena_used(const sdm_arena_t *arena) {
+  size_t used = 0;
+  for (; arena != NULL; arena = arena->next) used += arena->length;
+  return used;
+}
+
+sdm_arena_mark sdm_arena_get_mark(sdm_arena_t *arena) {
+  sdm_arena_t *chunk = sdm_arena_current(arena);
+  if (chunk->start == NULL) return (sdm_arena_mark){0};
+  sdm_arena_mark mark = { .chunk = chunk, .length = chunk->length, .last = chunk->last };
+  // Growing the allocation below the mark in place would leave it partly above the mark
+  chunk->last = chunk->length;
+  return mark;
+}
+
+// Empties the chunks taken into use since the mark. They stay mapped, to be reused.
+void sdm_arena_rewind(sdm_arena_t *arena, sdm_arena_mark mark) {
+  sdm_arena_t *current = sdm_arena_current(arena);
+  sdm_arena_t *chunk = (mark.chunk != NULL) ? mark.chunk : arena;
+  for (sdm_arena_t *later = chunk; later != current; later = later->next) {
+    later->next->length = 0;
+    later->next->last = 0;
+  }
+  chunk->length = mark.length;
+  chunk->last = mark.last;
+  // NULL rather than the arena itself, so the first chunk can still be copied by value
+  arena->current = (chunk != arena) ? chunk : NULL;
+}
 
-  SDM_FREE_AND_NULL(arena->next);
+size_t sdm_arena_chunks(const sdm_arena_t *arena) {
+  size_t chunks = 0;
+  for (; arena != NULL && arena->start != NULL; arena = arena->next) chunks++;
+  return chunks;
 }
 
 bool sdm_sv_compare(sdm_string_view SV1, sdm_string_view SV2) {
@@ -4,17 +4,28 @@
 /* This library provides the following:
  *
  * char *sdm_shift_args(int *argc, char ***argv);      Peel arguments off the **argv array typically provided to main, decrementing argc appropriately.
- * char *sdm_read_entire_file(const char *file_path);  Read the contents of a file into a character array. This character array is malloc'ed and so should be freed by the user.
+ * char *sdm_read_entire_file(const char *file_path);  Read the contents of a file into a NUL-terminated character array. This character array is malloc'ed and so should be freed by the user.
+ * sdm_string_view sdm_map_entire_file(const char *file_path);  Memory-map a file read-only. At least one page of zero bytes follows the contents.
+ * bool sdm_try_map_file(const char *file_path, sdm_string_view *contents);  As sdm_map_entire_file, but returns false (with errno set) instead of exiting on failure.
+ * void sdm_unmap_file(sdm_string_view contents);      Release a mapping made by sdm_map_entire_file.
+ * uint64_t sdm_hash_bytes(const void *data, size_t length);  A fast 64-bit hash of a block of memory, read a word at a time.
+ * uint64_t sdm_hash_bytes_salted(const void *data, size_t length, uint64_t salt);  The same hash, started from a different state for each salt. A salt of 0 gives sdm_hash_bytes.
+ * size_t sdm_next_pow2(size_t n);                    Return the smallest power of two that is at least n.
  * SDM_FREE_AND_NULL(ptr)                              Free the memory pointed to by ptr, and then set ptr to NULL.
  * #define SDM_FREE SDM_FREE_AND_NULL
  * #define SDM_MALLOC malloc
  * 
  * # DYNAMIC ARRAYS
  * ================
+ * SDM_ARRAY(type)                     The type of a dynamic array of type. Zero-initialise it before use.
+ * SDM_SMALL_ARRAY(type, n)            As SDM_ARRAY, but the first n items are kept in the struct itself. Use the SDM_SMALL_ARRAY_ macros on it, and don't copy it.
  * SDM_ENSURE_ARRAY_CAP(da, cap)       Ensure that the dynamic array, da, has a capacity equal-to cap. Realloc is used if needed.
  * SDM_ENSURE_ARRAY_MIN_CAP(da, cap)   Ensure that the dynamic array, da, has a capacity equal-to or greater-than cap. Realloc is used if needed.
- * DEFAULT_CAPACITY 128                Default capacity in bytes to be used when the capacity has not been set by the user.
+ * DEFAULT_CAPACITY 128                Default capacity in items to be used when the capacity has not been set by the user.
+ * SDM_ARRAY_RESERVE(da, count)        Make room for count more items in da, so the next count pushes don't allocate.
  * SDM_ARRAY_PUSH(da, item)            Push the value of item to the dynamic array, da, reallocing if needed.
+ * SDM_ARRAY_APPEND(da, items, count)  Push count items from the array items, growing da at most once.
+ * SDM_SMALL_ARRAY_RESERVE(da, count), SDM_SMALL_ARRAY_PUSH(da, item), SDM_SMALL_ARRAY_APPEND(da, items, count)  The same, for small arrays.
  * SDM_ARRAY_SWAP(da, ind1, ind2)      Swap the elements at the marked indices (if length==capacity this will extend the array)
  * SDM_ARRAY_FREE(da)                  Free the memory in the dynamic array, da, and zero things
  * SDM_ARRAY_RESET(da)                 Reset the length of the dynamic array, da, to zero, effectively emptying it. No memory is freed by this.
@@ -28,12 +39,33 @@
  * SDM_SV_F "%.*s"                                                             A printf helper.
  * SDM_SV_Vals(S) (int)(S).length, (S).data                                    A printf helper.
  * 
+ * # STRING INTERNING
+ * ==================
+ * uint32_t sdm_intern(sdm_interner *interner, sdm_string_view str);              Return the dense symbol ID of str, adding a copy of it to the interner if it is new.
+ * uint32_t sdm_intern_hashed(sdm_interner *interner, sdm_string_view str, uint32_t h);  As sdm_intern, for a caller that already has h = sdm_hash_bytes of str.
+ * uint32_t sdm_interner_hash(const sdm_interner *interner, uint32_t s);          Return the hash of a symbol's string, as stored when it was interned.
+ * sdm_string_view sdm_interner_string(const sdm_interner *interner, uint32_t s); Return the interned string for a symbol. It is NUL-terminated.
+ * bool sdm_interner_find(const sdm_interner *interner, sdm_string_view str, uint32_t *s);  Look up the symbol of str without adding it. Returns false if it was never interned.
+ * 
+ * # TYPED MAPS
+ * ============
+ * SDM_MAP(type)                       The type of a map from strings to values of type. Zero-initialise it before use.
+ * SDM_MAP_SET(map, key, value)        Set the value of key, adding a copy of key if it is new.
+ * SDM_MAP_GET(map, key, ptr)          Point ptr at the value of key, or set it to NULL if key is not in the map.
+ * sdm_dbl_map                         SDM_MAP(double), for names and their values.
+ * 
  * # MEMORY ARENA
  * ==============
  * #define SDM_ARENA_DEFAULT_CAP 256 * 1024*1024              Default capacity of the memory arena when not supplied by the user
- * void sdm_arena_init(sdm_arena_t *arena, size_t capacity);  Initialise a memory arena with a certain capacity and malloc the required space.
+ * void sdm_arena_init(sdm_arena_t *arena, size_t capacity);  Initialise a memory arena with a certain capacity, reserving (but not yet using) the space. Memory from an arena is not zeroed.
+ * SDM_ARENA_HUGE_PAGES                                       Define when building sdm_lib.c to ask for transparent huge pages for arena chunks.
  * void *sdm_arena_alloc(sdm_arena_t *arena, size_t size);    Allocate a region of size bytes in the given arena, and return a pointer to the start of this region.
+ * void *sdm_arena_realloc(sdm_arena_t *arena, void *ptr, size_t old_size, size_t size);  Resize a region of old_size bytes, in place if it was the last one allocated from its chunk.
  * void sdm_arena_free(sdm_arena_t *arena);                   Deallocate all memory in the arena, and zero everything
+ * size_t sdm_arena_used(const sdm_arena_t *arena);           Return the number of bytes allocated from the arena, over all of its chunks
+ * size_t sdm_arena_chunks(const sdm_arena_t *arena);         Return the number of chunks the arena has malloc'ed
+ * sdm_arena_mark sdm_arena_get_mark(sdm_arena_t *arena);     Record how far the arena has been allocated.
+ * void sdm_arena_rewind(sdm_arena_t *arena, sdm_arena_mark mark);  Release everything allocated since the mark was taken, keeping the chunks for reuse.
  */
 
 #include <stdbool.h>
@@ -50,17 +82,16 @@ do {                           \
 #define SDM_FREE SDM_FREE_AND_NULL
 #ifndef SDM_MALLOC
 void *active_alloc(size_t size);
-void *active_realloc(void *ptr, size_t size);
+void *active_realloc(void *ptr, size_t old_size, size_t size);
 #define SDM_MALLOC active_alloc
 #define SDM_REALLOC active_realloc
 #endif
 
-#define hash jenkins_one_at_a_time_hash
-
 #define SDM_ENSURE_ARRAY_CAP(da, cap) do {                     \
+    (da).data = SDM_REALLOC((da).data,                         \
+        (da).capacity * sizeof((da).data[0]),                  \
+        (cap) * sizeof((da).data[0]));                         \
     (da).capacity = cap;                                       \
-    (da).data = SDM_REALLOC((da).data,                             \
-        (da).capacity * sizeof((da).data[0]));                 \
     if ((da).data == NULL) {                                   \
       fprintf(stderr, "ERR: Couldn't alloc memory.\n");        \
       exit(1);                                                 \
@@ -68,14 +99,9 @@ void *active_realloc(void *ptr, size_t size);
   } while (0)
 
 #define SDM_ENSURE_ARRAY_MIN_CAP(da, cap) do {                 \
-    if ((da).capacity < cap) {                                 \
-      (da).capacity = cap;                                     \
-      (da).data = SDM_REALLOC((da).data,                           \
-          (da).capacity * sizeof((da).data[0]));               \
-      if ((da).data == NULL) {                                 \
-        fprintf(stderr, "ERR: Couldn't alloc memory. \n");     \
-        exit(1);                                               \
-      }                                                        \
+    if ((da).capacity < (cap)) {                               \
+      (da).data = sdm_array_grow((da).data, &(da).capacity,    \
+          (da).length, sizeof((da).data[0]), (cap), NULL, 0);  \
     }                                                          \
   } while (0)
 
@@ -83,27 +109,51 @@ void *active_realloc(void *ptr, size_t size);
 
 #define DEFAULT_CAPACITY 128
 
+#define SDM_ARRAY(type) struct { size_t capacity; size_t length; type *data; }
+#define SDM_SMALL_ARRAY(type, n) struct { size_t capacity; size_t length; type *data; type small[n]; }
+
+// Returns storage for at least min_capacity items, in place of data. The capacity doubles, so a run
+// of pushes only moves the array O(log n) times, and only the length live items are copied. A small
+// array starts out in its inline storage and moves to the arena once it outgrows it.
+void *sdm_array_grow(void *data, size_t *capacity, size_t length, size_t item_size, size_t min_capacity,
+                     void *small, size_t small_capacity);
+
+#define SDM_ARRAY_GROW_TO_FIT(da, count, small, small_capacity) do {                   \
+    if ((da).length + (count) > (da).capacity) {                                       \
+      (da).data = sdm_array_grow((da).data, &(da).capacity, (da).length,               \
+          sizeof((da).data[0]), (da).length + (count), (small), (small_capacity));     \
+    }                                                                                  \
+  } while (0)
+
+#define SDM_ARRAY_RESERVE(da, count) SDM_ARRAY_GROW_TO_FIT(da, count, NULL, 0)
+#define SDM_SMALL_ARRAY_RESERVE(da, count) \
+  SDM_ARRAY_GROW_TO_FIT(da, count, (da).small, sizeof((da).small) / sizeof((da).small[0]))
+
 #define SDM_ARRAY_PUSH(da, item) do {                             \
-    if (((da).capacity == 0) || ((da).data == NULL)) {            \
-      (da).capacity = DEFAULT_CAPACITY;                           \
-      (da).data = SDM_MALLOC((da).capacity * sizeof((da).data[0]));   \
-      if ((da).data == NULL) {                                    \
-        fprintf(stderr, "ERR: Couldn't alloc memory.\n");         \
-        exit(1);                                                  \
-      }                                                           \
-      memset((da).data, 0, (da).capacity * sizeof((da).data[0])); \
-    }                                                             \
-    while ((da).length >= (da).capacity) {                        \
-      (da).capacity *= 2;                                         \
-      (da).data = SDM_REALLOC((da).data,                              \
-           (da).capacity * sizeof((da).data[0]));                 \
-      if ((da).data == NULL) {                                    \
-        fprintf(stderr, "ERR: Couldn't alloc memory.\n");         \
-        exit(1);                                                  \
-      }                                                           \
-    }                                                             \
-    (da).data[(da).length++] = item;                              \
-  } while (0);
+    SDM_ARRAY_RESERVE(da, 1);                                     \
+    (da).data[(da).length++] = (item);                            \
+  } while (0)
+
+#define SDM_SMALL_ARRAY_PUSH(da, item) do {                       \
+    SDM_SMALL_ARRAY_RESERVE(da, 1);                               \
+    (da).data[(da).length++] = (item);                            \
+  } while (0)
+
+#define SDM_ARRAY_APPEND(da, items, count) do {                              \
+    size_t sdm_append_count = (count);                                       \
+    if (sdm_append_count == 0) break;                                        \
+    SDM_ARRAY_RESERVE(da, sdm_append_count);                                 \
+    memcpy(&(da).data[(da).length], (items), sdm_append_count * sizeof((da).data[0])); \
+    (da).length += sdm_append_count;                                         \
+  } while (0)
+
+#define SDM_SMALL_ARRAY_APPEND(da, items, count) do {                        \
+    size_t sdm_append_count = (count);                                       \
+    if (sdm_append_count == 0) break;                                        \
+    SDM_SMALL_ARRAY_RESERVE(da, sdm_append_count);                           \
+    memcpy(&(da).data[(da).length], (items), sdm_append_count * sizeof((da).data[0])); \
+    (da).length += sdm_append_count;                                         \
+  } while (0)
 
 #define SDM_ARRAY_SWAP(da, ind1, ind2)                                   \
 do {                                                                     \
@@ -116,10 +166,10 @@ do {                                                                     \
 } while (0)
 
 #define SDM_ARRAY_FREE(da) do {                                \
-    SDM_FREE((da).data);                                           \
+    SDM_FREE((da).data);                                       \
     (da).length = 0;                                           \
     (da).capacity = 0;                                         \
-  } while (0);
+  } while (0)
 
 #define SDM_ARRAY_RESET(da) do { (da).length = 0; } while (0)
 
@@ -134,6 +184,9 @@ typedef struct {
 char *sdm_shift_args(int *argc, char ***argv);
 
 char *sdm_read_entire_file(const char *file_path);
+sdm_string_view sdm_map_entire_file(const char *file_path);
+bool sdm_try_map_file(const char *file_path, sdm_string_view *contents);
+void sdm_unmap_file(sdm_string_view contents);
 
 sdm_string_view sdm_cstr_as_sv(char *cstr);
 char *sdm_sv_to_cstr(sdm_string_view sv);
@@ -147,95 +200,78 @@ void sdm_sv_trim(sdm_string_view *SV);
 int sdm_svncmp(sdm_string_view SV, const char *cmp);
 bool sdm_sv_compare(sdm_string_view SV1, sdm_string_view SV2);
 
-typedef struct {
-  char key[32];
-  double value;
-  bool occupied;
-} Dbl_KVPair;
+typedef SDM_ARRAY(sdm_string_view) sdm_sv_array;
+
+// Symbols are handed out in order starting from zero, so they can be used to index arrays.
+// The slots form an open-addressing table in the style of SwissTable. A control byte per slot holds
+// 7 bits of the string's hash (or SDM_INTERNER_EMPTY), and the slots are probed 16 at a time,
+// comparing all 16 control bytes at once. The hash of every string is kept (truncated to 32 bits),
+// so growing the table never rehashes, and a probe only compares strings whose hashes match.
+#define SDM_INTERNER_GROUP 16
+#define SDM_INTERNER_EMPTY 0x80
 
 typedef struct {
-  Dbl_KVPair *data;
-  size_t length;
-  size_t capacity;
-} DblArray;
-
-#define DEFAULT_HM_CAP 256
-
-#define SET_HM_CAPACITY(hm, cap)                                              \
-  do {                                                                        \
-    (hm)->capacity = (cap);                                                   \
-    if ((hm)->data == NULL) {                                                 \
-      (hm)->data = SDM_MALLOC(hm->capacity * sizeof(hm->data[0]));                \
-    }                                                                         \
-    else {                                                                    \
-      (hm)->data = SDM_REALLOC((hm)->data, (hm)->capacity * sizeof(hm->data[0])); \
-    }                                                                         \
-    if ((hm)->data == NULL) {                                                 \
-      fprintf(stderr, "ERR: Can't alloc.\n");                                 \
-      exit(1);                                                                \
-    }                                                                         \
-    memset((hm)->data, 0, (hm)->capacity * sizeof(hm->data[0]));              \
+  sdm_sv_array strings;
+  SDM_ARRAY(uint32_t) hashes;
+  uint8_t *ctrl;
+  uint32_t *slots;       // The symbol in each slot whose control byte isn't empty
+  size_t slot_capacity;  // A power of two, and a multiple of SDM_INTERNER_GROUP
+} sdm_interner;
+
+uint32_t sdm_intern(sdm_interner *interner, sdm_string_view str);
+uint32_t sdm_intern_hashed(sdm_interner *interner, sdm_string_view str, uint32_t h);
+uint32_t sdm_interner_hash(const sdm_interner *interner, uint32_t symbol);
+sdm_string_view sdm_interner_string(const sdm_interner *interner, uint32_t symbol);
+bool sdm_interner_find(const sdm_interner *interner, sdm_string_view str, uint32_t *symbol);
+
+// The keys are interned, and the value of a key is at its symbol in values, so values are in the
+// order their keys were first set and both grow like any other array.
+#define SDM_MAP(type) struct { sdm_interner keys; SDM_ARRAY(type) values; }
+
+#define SDM_MAP_SET(map, key, value)                                         \
+  do {                                                                       \
+    uint32_t sdm_map_index = sdm_intern(&(map).keys, (key));                 \
+    if (sdm_map_index == (map).values.length) SDM_ARRAY_PUSH((map).values, (value)); \
+    else (map).values.data[sdm_map_index] = (value);                         \
   } while (0)
 
-#define FREE_HASHMAP(hm) \
-  do {                   \
-    (hm).capacity = 0;   \
-    SDM_FREE((hm).data);     \
-  } while (0);
-
-#define GET_HASHMAP_INDEX(hm, value_of_key, index_addr)                      \
+#define SDM_MAP_GET(map, key, ptr)                                           \
   do {                                                                       \
-    *(index_addr) = -1;                                                      \
-    uint32_t location = get_hashmap_location((value_of_key), (hm).capacity); \
-    for (size_t offset=0; offset<(hm).capacity; offset++) {                  \
-      int new_location = (location + offset) % (hm).capacity;                \
-      if ((hm).data[new_location].occupied &&                                \
-        (strcmp((hm).data[new_location].key, (value_of_key))==0)) {          \
-        *(index_addr) = new_location;                                        \
-        break;                                                               \
-      }                                                                      \
-    }                                                                        \
+    uint32_t sdm_map_index;                                                  \
+    (ptr) = sdm_interner_find(&(map).keys, (key), &sdm_map_index) ?          \
+            &(map).values.data[sdm_map_index] : NULL;                        \
   } while (0)
 
-#define HM_VAL_AT(hm, index) \
-  (hm).data[index].value
-
-#define PUSH_TO_HASHMAP(hm1, value_of_key, value_of_value)                                   \
-  do {                                                                                       \
-    uint32_t location;                                                                       \
-    if ((hm1)->capacity == 0) {                                                              \
-      SET_HM_CAPACITY((hm1), DEFAULT_HM_CAP);                                                \
-    }                                                                                        \
-    if ((hm1)->length >= (hm1)->capacity) {                                                  \
-      fprintf(stderr, "Hashmap has insufficient capacity.\n");                               \
-      exit(1);                                                                               \
-    }                                                                                        \
-    location = get_hashmap_location((value_of_key), (hm1)->capacity);                        \
-                                                                                             \
-    if (!(hm1)->data[location].occupied ||                                                   \
-      ((hm1)->data[location].occupied && strcmp((value_of_key), (hm1)->data[location].key)==0)) {  \
-      strcpy((hm1)->data[location].key, (value_of_key));                                     \
-      (hm1)->data[location].value = (value_of_value);                                        \
-      (hm1)->data[location].occupied = true;                                                 \
-      (hm1)->length++;                                                                       \
-    } else {                                                                                 \
-      for (size_t i=1; i<(hm1)->capacity; i++) {                                             \
-        size_t new_location = (location + i) % (hm1)->capacity;                              \
-        if (!(hm1)->data[new_location].occupied ||                                           \
-          ((hm1)->data[new_location].occupied && strcmp((value_of_key), (hm1)->data[new_location].key)==0)) { \
-          strcpy((hm1)->data[new_location].key, (value_of_key));                             \
-          (hm1)->data[new_location].value = (value_of_value);                                \
-          (hm1)->data[new_location].occupied = true;                                         \
-          (hm1)->length++;                                                                   \
-          break;                                                                             \
-        }                                                                                    \
-      }                                                                                      \
-    }                                                                                        \
-  } while (0)
+typedef SDM_MAP(double) sdm_dbl_map;
+
+uint64_t sdm_hash_bytes(const void *data, size_t length);
+uint64_t sdm_hash_bytes_salted(const void *data, size_t length, uint64_t salt);
+
+// The full 128-bit product of a and b, as its high and low halves. Where the compiler has a 128-bit
+// type this is one multiply. Elsewhere (32-bit targets, MSVC) it is put together from 32-bit halves.
+static inline void sdm_mul_64x64(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo) {
+#ifdef __SIZEOF_INT128__
+  // __extension__ keeps -Wpedantic quiet about the type
+  __extension__ unsigned __int128 r = (unsigned __int128)a * b;
+  *hi = (uint64_t)(r >> 64);
+  *lo = (uint64_t)r;
+#else
+  uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+  uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+  uint64_t low = a_lo * b_lo;
+  uint64_t cross1 = a_hi * b_lo;
+  uint64_t cross2 = a_lo * b_hi;
+  uint64_t middle = (low >> 32) + (uint32_t)cross1 + (uint32_t)cross2;
+  *hi = a_hi * b_hi + (cross1 >> 32) + (cross2 >> 32) + (middle >> 32);
+  *lo = (middle << 32) | (uint32_t)low;
+#endif
+}
 
-void push_to_dblarray(DblArray *hm, char *key, double value);
-uint32_t get_hashmap_location(const char* key, size_t capacity);
-uint32_t jenkins_one_at_a_time_hash(const uint8_t* key, size_t length);
+static inline size_t sdm_next_pow2(size_t n) {
+  size_t p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
 
 #define SDM_ARENA_DEFAULT_CAP 256 * 1024*1024
 
@@ -246,13 +282,36 @@ struct sdm_arena_t {
   size_t capacity;
   unsigned char *start;
   size_t alignment;
+  size_t last;  // Offset of the most recent allocation in this chunk, which can grow in place
   sdm_arena_t *next;
+  sdm_arena_t *current;  // Only used in the first chunk: the chunk allocations come from
 };
 
 void sdm_arena_init(sdm_arena_t *arena, size_t capacity);
 void *sdm_arena_alloc(sdm_arena_t *arena, size_t size);
-void *sdm_arena_realloc(sdm_arena_t *arena, void *ptr, size_t size);
+void *sdm_arena_realloc(sdm_arena_t *arena, void *ptr, size_t old_size, size_t size);
 void sdm_arena_free(sdm_arena_t *arena);
+size_t sdm_arena_used(const sdm_arena_t *arena);
+size_t sdm_arena_chunks(const sdm_arena_t *arena);
+
+// A point to rewind an arena to. Marks must be rewound in the reverse order they were taken.
+typedef struct {
+  sdm_arena_t *chunk;  // The current chunk when the mark was taken, or NULL if there was none
+  size_t length;
+  size_t last;
+} sdm_arena_mark;
+
+sdm_arena_mark sdm_arena_get_mark(sdm_arena_t *arena);
+void sdm_arena_rewind(sdm_arena_t *arena, sdm_arena_mark mark);
+
+// Like active_alloc and active_realloc, this is provided by the application. It makes arena the
+// target of SDM_MALLOC and SDM_REALLOC on the calling thread, and returns the previous one.
+sdm_arena_t *swap_active_arena(sdm_arena_t *arena);
+
+// Also provided by the application: an arena for the calling thread, for work that doesn't outlive
+// the function doing it. Take a mark on entry and rewind to it on the way out, and swap it in with
+// swap_active_arena around the allocations that should go there.
+sdm_arena_t *scratch_arena(void);
 
 #endif /* ifndef _SDM_LIB_H */
 
@@ -0,0 +1,303 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "token_cache.h"
+
+static_assert(sizeof(TokenCacheHeader) == 72, "The cache header must not have padding");
+
+static const char token_cache_magic[4] = { 'L', 'L', 'T', 'C' };
+
+// Symbols and string literals are stored as the span of the input they were lexed from
+typedef struct {
+  uint32_t offset;
+  uint32_t length;
+} TokenCacheSpan;
+
+// After the header come, in this order: ints, floats, offsets, payloads, symbol spans, symbol hashes,
+// string spans and types. The 8-byte sections come first and all but the types are a multiple of 4
+// bytes, so every section stays aligned.
+typedef struct {
+  size_t ints;
+  size_t floats;
+  size_t offsets;
+  size_t payloads;
+  size_t symbols;
+  size_t hashes;
+  size_t strings;
+  size_t types;
+  size_t end;
+} TokenCacheLayout;
+
+static TokenCacheLayout token_cache_layout(const TokenCacheHeader *header) {
+  TokenCacheLayout layout = {0};
+  layout.ints = sizeof(TokenCacheHeader);
+  layout.floats = layout.ints + header->int_count * sizeof(int64_t);
+  layout.offsets = layout.floats + header->float_count * sizeof(double);
+  layout.payloads = layout.offsets + header->token_count * sizeof(uint32_t);
+  layout.symbols = layout.payloads + header->token_count * sizeof(uint32_t);
+  layout.hashes = layout.symbols + header->symbol_count * sizeof(TokenCacheSpan);
+  layout.strings = layout.hashes + header->symbol_count * sizeof(uint32_t);
+  layout.types = layout.strings + header->string_count * sizeof(TokenCacheSpan);
+  layout.end = layout.types + header->token_count * sizeof(uint8_t);
+  return layout;
+}
+
+// Returns "<cache_dir>/<hash>.llt". The string is allocated in the active arena.
+static char *token_cache_path(const char *cache_dir, uint64_t content_hash) {
+  size_t size = strlen(cache_dir) + 32;
+  char *path = SDM_MALLOC(size);
+  if (path == NULL) {
+    fprintf(stderr, "Memory problem. Aborting.\n");
+    exit(1);
+  }
+  snprintf(path, size, "%s/%016llx.llt", cache_dir, (unsigned long long)content_hash);
+  return path;
+}
+
+static bool token_cache_spans_fit(const TokenCacheSpan *spans, size_t count, size_t length) {
+  for (size_t i=0; i<count; i++) {
+    if ((uint64_t)spans[i].offset + spans[i].length > length) return false;
+  }
+  return true;
+}
+
+// Every type, and every payload that indexes something, has to be in range, or a corrupt file would
+// be read out of bounds later. The symbol hashes can't be checked without hashing the names again,
+// which is what storing them saves. A wrong one only costs a duplicate symbol, not a bad read.
+static bool token_cache_tokens_fit(const TokenCacheHeader *header, const uint8_t *types, const uint32_t *offsets,
+                                   const uint32_t *payloads, size_t length) {
+  for (size_t i=0; i<header->token_count; i++) {
+    if (offsets[i] > length) return false;
+    uint32_t payload = payloads[i];
+    switch ((TokenType)types[i]) {
+      case TOKEN_TYPE_ID: if (payload >= header->symbol_count) return false; break;
+      case TOKEN_TYPE_INT: if (payload >= header->int_count) return false; break;
+      case TOKEN_TYPE_FLOAT: if (payload >= header->float_count) return false; break;
+      case TOKEN_TYPE_STRING: if (payload >= header->string_count) return false; break;
+      case TOKEN_TYPE_KEYWORD: if (payload >= KEYWORD_COUNT) return false; break;
+      case TOKEN_TYPE_UNKNOWN:
+      case TOKEN_TYPE_ASSIGNMENT:
+      case TOKEN_TYPE_ADD:
+      case TOKEN_TYPE_MULT:
+      case TOKEN_TYPE_SUB:
+      case TOKEN_TYPE_DIV:
+      case TOKEN_TYPE_OPAREN:
+      case TOKEN_TYPE_CPAREN:
+      case TOKEN_TYPE_SEMICOLON:
+      case TOKEN_TYPE_COLON:
+      case TOKEN_TYPE_COMMA:
+      case TOKEN_TYPE_POINT:
+      case TOKEN_TYPE_EOF:
+      case TOKEN_TYPE_QUOTEMARK: break;
+      case TOKEN_TYPE_COUNT:
+      default: return false;
+    }
+  }
+  return true;
+}
+
+// Checks the header against the input, that the sections exactly fill the file, and that everything
+// they refer to is in range.
+static bool token_cache_check(sdm_string_view file, sdm_string_view contents, uint64_t content_hash, TokenCacheHeader *header) {
+  if (file.length < sizeof(*header)) return false;
+  memcpy(header, file.data, sizeof(*header));
+  if (memcmp(header->magic, token_cache_magic, sizeof(token_cache_magic)) != 0) return false;
+  if (header->version != TOKEN_CACHE_VERSION) return false;
+  if (header->content_hash != content_hash || header->content_length != contents.length) return false;
+  // Only hashed once there is a file with the right name, so a miss costs no more than before
+  if (header->content_check != sdm_hash_bytes_salted(contents.data, contents.length, TOKEN_CACHE_CHECK_SALT)) return false;
+  // Every entry takes at least a byte, so this also keeps the layout sums from overflowing
+  if (header->token_count > file.length || header->symbol_count > file.length ||
+      header->int_count > file.length || header->float_count > file.length ||
+      header->string_count > file.length) return false;
+  TokenCacheLayout layout = token_cache_layout(header);
+  if (layout.end != file.length) return false;
+  const TokenCacheSpan *symbol_spans = (const TokenCacheSpan*)(file.data + layout.symbols);
+  const TokenCacheSpan *string_spans = (const TokenCacheSpan*)(file.data + layout.strings);
+  const uint8_t *types = (const uint8_t*)(file.data + layout.types);
+  const uint32_t *offsets = (const uint32_t*)(file.data + layout.offsets);
+  const uint32_t *payloads = (const uint32_t*)(file.data + layout.payloads);
+  return token_cache_spans_fit(symbol_spans, header->symbol_count, contents.length) &&
+         token_cache_spans_fit(string_spans, header->string_count, contents.length) &&
+         token_cache_tokens_fit(header, types, offsets, payloads, contents.length);
+}
+
+bool token_cache_load(const char *cache_dir, Tokeniser *tokeniser, TokenArray *t_array, sdm_string_view *mapping) {
+  sdm_string_view contents = tokeniser->contents;
+  uint64_t content_hash = sdm_hash_bytes(contents.data, contents.length);
+  sdm_arena_t *scratch = scratch_arena();
+  sdm_arena_mark scratch_mark = sdm_arena_get_mark(scratch);
+  sdm_arena_t *previous = swap_active_arena(scratch);
+  char *path = token_cache_path(cache_dir, content_hash);
+  swap_active_arena(previous);
+  sdm_string_view file;
+  bool mapped = sdm_try_map_file(path, &file);
+  sdm_arena_rewind(scratch, scratch_mark);
+  if (!mapped) return false;
+  TokenCacheHeader header;
+  if (!token_cache_check(file, contents, content_hash, &header)) {
+    sdm_unmap_file(file);
+    return false;
+  }
+  TokenCacheLayout layout = token_cache_layout(&header);
+  const TokenCacheSpan *symbol_spans = (const TokenCacheSpan*)(file.data + layout.symbols);
+  const uint32_t *symbol_hashes = (const uint32_t*)(file.data + layout.hashes);
+  const TokenCacheSpan *string_spans = (const TokenCacheSpan*)(file.data + layout.strings);
+
+  // The file numbers symbols densely in order of first use. Usually the symbol table starts out
+  // empty, so they get the same numbers here and the payloads can be used as they are.
+  sdm_interner *symbols = tokeniser->symbols ? tokeniser->symbols : ll_symbol_table();
+  uint32_t *symbol_map = malloc(header.symbol_count * sizeof(symbol_map[0]) + 1);
+  if (symbol_map == NULL) {
+    fprintf(stderr, "Memory problem. Aborting.\n");
+    exit(1);
+  }
+  bool same_symbols = true;
+  for (size_t i=0; i<header.symbol_count; i++) {
+    TokenCacheSpan span = symbol_spans[i];
+    sdm_string_view name = sdm_sized_str_as_sv(contents.data + span.offset, span.length);
+    symbol_map[i] = sdm_intern_hashed(symbols, name, symbol_hashes[i]);
+    same_symbols = same_symbols && symbol_map[i] == i;
+  }
+
+  token_array_attach(t_array, tokeniser);
+  t_array->length = header.token_count;
+  t_array->capacity = header.token_count;
+  t_array->types = (uint8_t*)(file.data + layout.types);
+  t_array->offsets = (uint32_t*)(file.data + layout.offsets);
+  t_array->payloads = (uint32_t*)(file.data + layout.payloads);
+  if (!same_symbols) {
+    uint32_t *payloads = SDM_MALLOC(header.token_count * sizeof(payloads[0]) + 1);
+    if (payloads == NULL) {
+      fprintf(stderr, "Memory problem. Aborting.\n");
+      exit(1);
+    }
+    for (size_t i=0; i<header.token_count; i++) {
+      uint32_t payload = t_array->payloads[i];
+      payloads[i] = (t_array->types[i] == TOKEN_TYPE_ID) ? symbol_map[payload] : payload;
+    }
+    t_array->payloads = payloads;
+  }
+  t_array->ints.data = (int64_t*)(file.data + layout.ints);
+  t_array->ints.length = t_array->ints.capacity = header.int_count;
+  t_array->floats.data = (double*)(file.data + layout.floats);
+  t_array->floats.length = t_array->floats.capacity = header.float_count;
+  memset(&t_array->strings, 0, sizeof(t_array->strings));
+  SDM_ARRAY_RESERVE(t_array->strings, header.string_count);
+  // Outside zero_copy mode, string values are NUL-terminated copies, as they are when lexed
+  for (size_t i=0; i<header.string_count; i++) {
+    TokenCacheSpan span = string_spans[i];
+    sdm_string_view value = sdm_sized_str_as_sv(contents.data + span.offset, span.length);
+    if (!tokeniser->zero_copy) value.data = sdm_sv_to_cstr(value);
+    SDM_ARRAY_PUSH(t_array->strings, value);
+  }
+
+  free(symbol_map);
+  tokeniser->index = contents.length;
+  *mapping = file;
+  return true;
+}
+
+static bool token_cache_write(FILE *f, const void *data, size_t size) {
+  return size == 0 || fwrite(data, size, 1, f) == 1;
+}
+
+void token_cache_store(const char *cache_dir, const TokenArray *t_array) {
+  // The file keeps offsets and spans in 32 bits, so inputs past the first block aren't cached
+  if ((uint64_t)t_array->contents.length >> TOKEN_ARRAY_BLOCK_BITS) return;
+  size_t n = t_array->length;
+  const sdm_interner *symbols = t_array->symbols ? t_array->symbols : ll_symbol_table();
+  size_t symbol_total = symbols->strings.length;
+
+  // Gather the literals in token order, so pool entries that no token uses any more are dropped,
+  // and renumber the symbols in order of first use
+  uint32_t *payloads = malloc(n * sizeof(payloads[0]) + 1);
+  uint32_t *symbol_map = malloc(symbol_total * sizeof(symbol_map[0]) + 1);
+  TokenCacheSpan *symbol_spans = malloc(symbol_total * sizeof(symbol_spans[0]) + 1);
+  uint32_t *symbol_hashes = malloc(symbol_total * sizeof(symbol_hashes[0]) + 1);
+  TokenCacheSpan *string_spans = malloc(t_array->strings.length * sizeof(string_spans[0]) + 1);
+  int64_t *ints = malloc(t_array->ints.length * sizeof(ints[0]) + 1);
+  double *floats = malloc(t_array->floats.length * sizeof(floats[0]) + 1);
+  if (!payloads || !symbol_map || !symbol_spans || !symbol_hashes || !string_spans || !ints || !floats) {
+    fprintf(stderr, "Memory problem. Aborting.\n");
+    exit(1);
+  }
+  for (size_t i=0; i<symbol_total; i++) symbol_map[i] = UINT32_MAX;
+
+  TokenCacheHeader header = {0};
+  memcpy(header.magic, token_cache_magic, sizeof(header.magic));
+  header.version = TOKEN_CACHE_VERSION;
+  header.content_hash = sdm_hash_bytes(t_array->contents.data, t_array->contents.length);
+  header.content_check = sdm_hash_bytes_salted(t_array->contents.data, t_array->contents.length, TOKEN_CACHE_CHECK_SALT);
+  header.content_length = t_array->contents.length;
+  header.token_count = n;
+  for (size_t i=0; i<n; i++) {
+    uint32_t payload = t_array->payloads[i];
+    switch (t_array->types[i]) {
+      case TOKEN_TYPE_ID: {
+        if (symbol_map[payload] == UINT32_MAX) {
+          symbol_map[payload] = header.symbol_count;
+          uint32_t length = sdm_interner_string(symbols, payload).length;
+          symbol_spans[header.symbol_count] = (TokenCacheSpan){ t_array->offsets[i], length };
+          symbol_hashes[header.symbol_count++] = sdm_interner_hash(symbols, payload);
+        }
+        payload = symbol_map[payload];
+      } break;
+      case TOKEN_TYPE_INT: {
+        ints[header.int_count] = t_array->ints.data[payload];
+        payload = header.int_count++;
+      } break;
+      case TOKEN_TYPE_FLOAT: {
+        floats[header.float_count] = t_array->floats.data[payload];
+        payload = header.float_count++;
+      } break;
+      case TOKEN_TYPE_STRING: {
+        // The value starts just after the opening quotemark
+        uint32_t length = t_array->strings.data[payload].length;
+        string_spans[header.string_count] = (TokenCacheSpan){ t_array->offsets[i] + 1, length };
+        payload = header.string_count++;
+      } break;
+      default: break;
+    }
+    payloads[i] = payload;
+  }
+
+  // Write to a temporary file and rename it into place, so a concurrent reader never sees half a file
+  sdm_arena_t *scratch = scratch_arena();
+  sdm_arena_mark scratch_mark = sdm_arena_get_mark(scratch);
+  sdm_arena_t *previous = swap_active_arena(scratch);
+  char *path = token_cache_path(cache_dir, header.content_hash);
+  size_t tmp_size = strlen(path) + 32;
+  char *tmp_path = SDM_MALLOC(tmp_size);
+  snprintf(tmp_path, tmp_size, "%s.%ld.tmp", path, (long)getpid());
+  FILE *f = fopen(tmp_path, "wb");
+  bool ok = f != NULL &&
+    token_cache_write(f, &header, sizeof(header)) &&
+    token_cache_write(f, ints, header.int_count * sizeof(ints[0])) &&
+    token_cache_write(f, floats, header.float_count * sizeof(floats[0])) &&
+    token_cache_write(f, t_array->offsets, n * sizeof(t_array->offsets[0])) &&
+    token_cache_write(f, payloads, n * sizeof(payloads[0])) &&
+    token_cache_write(f, symbol_spans, header.symbol_count * sizeof(symbol_spans[0])) &&
+    token_cache_write(f, symbol_hashes, header.symbol_count * sizeof(symbol_hashes[0])) &&
+    token_cache_write(f, string_spans, header.string_count * sizeof(string_spans[0])) &&
+    token_cache_write(f, t_array->types, n * sizeof(t_array->types[0]));
+  if (f != NULL && fclose(f) != 0) ok = false;
+  if (ok && rename(tmp_path, path) != 0) ok = false;
+  if (!ok) {
+    fprintf(stderr, "WARNING: Could not write token cache %s: %s\n", path, strerror(errno));
+    remove(tmp_path);
+  }
+  swap_active_arena(previous);
+  sdm_arena_rewind(scratch, scratch_mark);
+
+  free(payloads);
+  free(symbol_map);
+  free(symbol_spans);
+  free(symbol_hashes);
+  free(string_spans);
+  free(ints);
+  free(floats);
+}
@@ -0,0 +1,44 @@
+#ifndef _TOKEN_CACHE_H
+#define _TOKEN_CACHE_H
+
+#include "token_lib.h"
+
+// An on-disk cache of lexed token arrays. Each entry is one file in the cache directory, named after
+// a hash of the input it was lexed from. The file holds the token columns and literal pools exactly
+// as they are laid out in a TokenArray, so a hit maps the file and points the array straight at it.
+// Symbols and string literals are stored as spans of the input, so the input has to stay mapped.
+// Each symbol also keeps its hash, so loading interns the names without hashing them again.
+//
+// The format is tied to this build: the header records TOKEN_CACHE_VERSION, and a file written by a
+// different version, or on a machine with a different byte order, is just a miss. Bump the version
+// whenever the lexer or the layout changes what a cached file would hold.
+#define TOKEN_CACHE_VERSION 3
+
+// The file is named after sdm_hash_bytes of the input, and content_check is a second hash of it with
+// this salt. A hit needs both to match, so two inputs would have to collide in 128 bits to be mixed up.
+#define TOKEN_CACHE_CHECK_SALT 0x9E3779B97F4A7C15ull
+
+typedef struct {
+  char magic[4];  // "LLTC"
+  uint32_t version;
+  uint64_t content_hash;
+  uint64_t content_check;
+  uint64_t content_length;
+  uint64_t token_count;
+  uint64_t symbol_count;
+  uint64_t int_count;
+  uint64_t float_count;
+  uint64_t string_count;
+} TokenCacheHeader;
+
+// Looks up the tokens of tokeniser->contents in cache_dir. On a hit, t_array is filled in and the
+// mapped cache file is returned in *mapping, to be released with sdm_unmap_file once the array is no
+// longer needed. The array's columns are read-only, so it can't be pushed to or edited. Returns false
+// on a miss, including when the file is missing, from another version, or malformed.
+bool token_cache_load(const char *cache_dir, Tokeniser *tokeniser, TokenArray *t_array, sdm_string_view *mapping);
+
+// Writes t_array to cache_dir. The cache is only an optimisation, so failing to write it is reported
+// as a warning rather than an error.
+void token_cache_store(const char *cache_dir, const TokenArray *t_array);
+
+#endif // !_TOKEN_CACHE_H
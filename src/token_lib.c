@@ -1,11 +1,21 @@
+// For read() and ssize_t when building with -std=c18
+#define _DEFAULT_SOURCE
+
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #include "token_lib.h"
 #include "sdm_lib.h"
+#include "pow10_table.h"
 
 char *TT_string[] = {
   [TOKEN_TYPE_UNKNOWN]    = "TOKEN_TYPE_UNKNOWN",
@@ -30,28 +40,68 @@ char *TT_string[] = {
   [TOKEN_TYPE_COUNT]      = "TOKEN_TYPE_COUNT",
 };
 
-char *keyword_strings[] = {
-  [KEYWORD_LET] = "let",
+const char *keyword_strings[] = {
+#define X(name, text, first, last) [name] = text,
+  LL_KEYWORDS(X)
+#undef X
 };
 static_assert(
   sizeof(keyword_strings) / sizeof(keyword_strings[0]) == KEYWORD_COUNT, 
   "Wrong number of keywords"
 );
 
-void print_token_array(TokenArray token_array) {
-  for (size_t i=0; i<token_array.length; i++) {
-    Token t = token_array.data[i];
-    TokenType tt = t.token_type;
-    printf("%s", TT_string[tt]);
-    if (tt == TOKEN_TYPE_ID)
-      printf(" :: %s", t.as.id_token.value);
-    else if (tt == TOKEN_TYPE_INT) 
-      printf(" :: %ld", t.as.int_token.value);
-    else if (tt == TOKEN_TYPE_FLOAT) 
-      printf(" :: %f", t.as.float_token.value);
-    else if (tt == TOKEN_TYPE_KEYWORD) 
-      printf(" :: %s", keyword_strings[t.as.kw_token.value]);
-    printf("\n");
+static const uint8_t keyword_lengths[] = {
+#define X(name, text, first, last) [name] = sizeof(text) - 1,
+  LL_KEYWORDS(X)
+#undef X
+};
+
+// A perfect hash over the keywords, filled in at compile time. Each slot holds a KeyWords value plus
+// one, or zero if no keyword hashes there. If a new keyword collides with an old one, -Woverride-init
+// reports the duplicate initialiser. Then change the multipliers in KEYWORD_HASH or grow the table.
+#define KEYWORD_TABLE_SIZE 16
+#define KEYWORD_HASH(len, first, last) \
+  (((len) + 3 * (unsigned char)(first) + 5 * (unsigned char)(last)) & (KEYWORD_TABLE_SIZE - 1))
+static_assert(KEYWORD_COUNT < KEYWORD_TABLE_SIZE, "The keyword table is too small");
+
+static const uint8_t keyword_table[KEYWORD_TABLE_SIZE] = {
+#define X(name, text, first, last) [KEYWORD_HASH(sizeof(text) - 1, first, last)] = name + 1,
+  LL_KEYWORDS(X)
+#undef X
+};
+
+// Returns the keyword spelled by text[0..len), or KEYWORD_COUNT if it isn't one
+static inline KeyWords keyword_lookup(const char *text, size_t len) {
+  uint8_t slot = keyword_table[KEYWORD_HASH(len, text[0], text[len-1])];
+  if (slot == 0) return KEYWORD_COUNT;
+  KeyWords kw = slot - 1;
+  if (keyword_lengths[kw] != len || memcmp(keyword_strings[kw], text, len) != 0) return KEYWORD_COUNT;
+  return kw;
+}
+
+static sdm_interner ll_symbols = {0};
+
+sdm_interner *ll_symbol_table(void) {
+  return &ll_symbols;
+}
+
+void print_token(Token t) {
+  TokenType tt = t.token_type;
+  printf("%s", TT_string[tt]);
+  if (tt == TOKEN_TYPE_ID)
+    printf(" :: "SDM_SV_F, SDM_SV_Vals(t.as.id_token.value));
+  else if (tt == TOKEN_TYPE_INT) 
+    printf(" :: %ld", t.as.int_token.value);
+  else if (tt == TOKEN_TYPE_FLOAT) 
+    printf(" :: %f", t.as.float_token.value);
+  else if (tt == TOKEN_TYPE_KEYWORD) 
+    printf(" :: %s", keyword_strings[t.as.kw_token.value]);
+  printf("\n");
+}
+
+void print_token_array(const TokenArray *t_array) {
+  for (size_t i=0; i<t_array->length; i++) {
+    print_token(token_array_get(t_array, i));
   }
 }
 
@@ -59,30 +109,348 @@ char *get_current_tokeniser_string(Tokeniser tokeniser) {
   return tokeniser.contents.data + tokeniser.index;
 }
 
-void advance_to_next_line(Tokeniser *tokeniser) {
-  while (tokeniser->contents.data[tokeniser->index] != '\n') {
-    tokeniser->index++;
+// Vectorised scanning helpers. These only load whole vectors that lie inside [data, data+length),
+// and finish with a scalar loop, so they never read past the end of the buffer.
+// The AVX2 paths are only compiled in when the compiler targets AVX2 (e.g. -mavx2 or -march=native).
+
+static inline bool is_space_byte(unsigned char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Returns the index of the first '\n' at or after index, or length if there is none.
+static size_t find_newline(const char *data, size_t index, size_t length) {
+#if defined(__AVX2__)
+  const __m256i nl32 = _mm256_set1_epi8('\n');
+  while (index + 32 <= length) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(data + index));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl32));
+    if (mask) return index + __builtin_ctz(mask);
+    index += 32;
   }
-  tokeniser->index++;
-  if (tokeniser->index < tokeniser->contents.length) {
-    tokeniser->line++;
-    tokeniser->col = 1;
+#endif
+#if defined(__SSE2__)
+  const __m128i nl16 = _mm_set1_epi8('\n');
+  while (index + 16 <= length) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(data + index));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl16));
+    if (mask) return index + __builtin_ctz(mask);
+    index += 16;
   }
+#endif
+  while (index < length && data[index] != '\n') index++;
+  return index;
+}
+
+// Handles one block of bytes whose whitespace bitmask has been computed. Returns true if the run
+// of whitespace ends inside this block.
+static inline bool consume_space_mask(uint32_t space_mask, size_t width, size_t *index) {
+  uint32_t full = (width == 32) ? 0xFFFFFFFFu : ((1u << width) - 1);
+  uint32_t not_space = ~space_mask & full;
+  *index += not_space ? (size_t)__builtin_ctz(not_space) : width;
+  return not_space != 0;
+}
+
+// Skips a run of whitespace starting at index. Returns the index of the first non-whitespace byte.
+static size_t skip_whitespace(const char *data, size_t index, size_t length) {
+#if defined(__AVX2__)
+  const __m256i space32 = _mm256_set1_epi8(' ');
+  const __m256i tab32 = _mm256_set1_epi8('\t');
+  const __m256i ctl_range32 = _mm256_set1_epi8('\r' - '\t');
+  while (index + 32 <= length) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(data + index));
+    // '\t'..'\r' is tested as an unsigned range: (v - '\t') <= ('\r' - '\t')
+    __m256i off = _mm256_sub_epi8(v, tab32);
+    __m256i is_ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(off, ctl_range32), off);
+    __m256i is_space = _mm256_or_si256(is_ctl, _mm256_cmpeq_epi8(v, space32));
+    uint32_t space_mask = (uint32_t)_mm256_movemask_epi8(is_space);
+    if (consume_space_mask(space_mask, 32, &index)) return index;
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i space16 = _mm_set1_epi8(' ');
+  const __m128i tab16 = _mm_set1_epi8('\t');
+  const __m128i ctl_range16 = _mm_set1_epi8('\r' - '\t');
+  while (index + 16 <= length) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(data + index));
+    __m128i off = _mm_sub_epi8(v, tab16);
+    __m128i is_ctl = _mm_cmpeq_epi8(_mm_min_epu8(off, ctl_range16), off);
+    __m128i is_space = _mm_or_si128(is_ctl, _mm_cmpeq_epi8(v, space16));
+    uint32_t space_mask = (uint32_t)_mm_movemask_epi8(is_space);
+    if (consume_space_mask(space_mask, 16, &index)) return index;
+  }
+#endif
+  while (index < length && is_space_byte(data[index])) index++;
+  return index;
+}
+
+void advance_to_next_line(Tokeniser *tokeniser) {
+  tokeniser->index = find_newline(tokeniser->contents.data, tokeniser->index, tokeniser->contents.length);
+  if (tokeniser->index < tokeniser->contents.length) tokeniser->index++;
 }
 
 bool starts_with_comment(Tokeniser tokeniser) {
   const char *comment_marker = "//";
-  return strncmp(get_current_tokeniser_string(tokeniser), comment_marker, strlen(comment_marker)) == 0;
+  size_t marker_len = strlen(comment_marker);
+  if (tokeniser.contents.length - tokeniser.index < marker_len) return false;
+  return strncmp(get_current_tokeniser_string(tokeniser), comment_marker, marker_len) == 0;
 }
 
-size_t starts_with_float(Tokeniser tokeniser) {
-  char *endptr;
-  char *input = get_current_tokeniser_string(tokeniser);
-  errno = 0;
-  strtod(input, &endptr);
-  if (errno != 0) return 0;
-  size_t retval = endptr - input;
-  return retval;
+// Character classes for the table-driven lexer. Every byte is looked up once in char_class, and
+// get_next_token_dfa dispatches on that class instead of walking a chain of comparisons. Numbers
+// are recognised by the small DFA in number_dfa, using maximal munch: we remember the last
+// accepting state and back off to it.
+typedef enum {
+  CC_OTHER = 0,
+  CC_SPACE,
+  CC_NEWLINE,
+  CC_ALPHA,
+  CC_EXP,        // 'e' and 'E': part of an identifier, or the exponent marker in a number
+  CC_DIGIT,
+  CC_UNDERSCORE,
+  CC_SIGN,
+  CC_DOT,
+  CC_SLASH,
+  CC_QUOTE,
+  CC_PUNCT,
+  CC_COUNT,
+} CharClass;
+
+static const uint8_t char_class[256] = {
+  [' ']  = CC_SPACE, ['\t'] = CC_SPACE, ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+  ['\n'] = CC_NEWLINE,
+  ['a'] = CC_ALPHA, ['b'] = CC_ALPHA, ['c'] = CC_ALPHA, ['d'] = CC_ALPHA, ['e'] = CC_EXP,   ['f'] = CC_ALPHA, ['g'] = CC_ALPHA, ['h'] = CC_ALPHA,
+  ['i'] = CC_ALPHA, ['j'] = CC_ALPHA, ['k'] = CC_ALPHA, ['l'] = CC_ALPHA, ['m'] = CC_ALPHA, ['n'] = CC_ALPHA, ['o'] = CC_ALPHA, ['p'] = CC_ALPHA,
+  ['q'] = CC_ALPHA, ['r'] = CC_ALPHA, ['s'] = CC_ALPHA, ['t'] = CC_ALPHA, ['u'] = CC_ALPHA, ['v'] = CC_ALPHA, ['w'] = CC_ALPHA, ['x'] = CC_ALPHA,
+  ['y'] = CC_ALPHA, ['z'] = CC_ALPHA,
+  ['A'] = CC_ALPHA, ['B'] = CC_ALPHA, ['C'] = CC_ALPHA, ['D'] = CC_ALPHA, ['E'] = CC_EXP,   ['F'] = CC_ALPHA, ['G'] = CC_ALPHA, ['H'] = CC_ALPHA,
+  ['I'] = CC_ALPHA, ['J'] = CC_ALPHA, ['K'] = CC_ALPHA, ['L'] = CC_ALPHA, ['M'] = CC_ALPHA, ['N'] = CC_ALPHA, ['O'] = CC_ALPHA, ['P'] = CC_ALPHA,
+  ['Q'] = CC_ALPHA, ['R'] = CC_ALPHA, ['S'] = CC_ALPHA, ['T'] = CC_ALPHA, ['U'] = CC_ALPHA, ['V'] = CC_ALPHA, ['W'] = CC_ALPHA, ['X'] = CC_ALPHA,
+  ['Y'] = CC_ALPHA, ['Z'] = CC_ALPHA,
+  ['0'] = CC_DIGIT, ['1'] = CC_DIGIT, ['2'] = CC_DIGIT, ['3'] = CC_DIGIT, ['4'] = CC_DIGIT, ['5'] = CC_DIGIT, ['6'] = CC_DIGIT, ['7'] = CC_DIGIT,
+  ['8'] = CC_DIGIT, ['9'] = CC_DIGIT,
+  ['_'] = CC_UNDERSCORE,
+  ['+'] = CC_SIGN, ['-'] = CC_SIGN,
+  ['.'] = CC_DOT,
+  ['/'] = CC_SLASH,
+  ['"'] = CC_QUOTE,
+  [','] = CC_PUNCT, ['='] = CC_PUNCT, ['*'] = CC_PUNCT, [':'] = CC_PUNCT, [';'] = CC_PUNCT, ['('] = CC_PUNCT, [')'] = CC_PUNCT,
+};
+
+static const TokenType single_char_token[256] = {
+  [','] = TOKEN_TYPE_COMMA,
+  ['.'] = TOKEN_TYPE_POINT,
+  ['+'] = TOKEN_TYPE_ADD,
+  ['-'] = TOKEN_TYPE_SUB,
+  ['='] = TOKEN_TYPE_ASSIGNMENT,
+  ['/'] = TOKEN_TYPE_DIV,
+  ['*'] = TOKEN_TYPE_MULT,
+  [':'] = TOKEN_TYPE_COLON,
+  [';'] = TOKEN_TYPE_SEMICOLON,
+  ['('] = TOKEN_TYPE_OPAREN,
+  [')'] = TOKEN_TYPE_CPAREN,
+};
+
+typedef enum {
+  NUM_REJECT = 0,
+  NUM_START,
+  NUM_SIGN,
+  NUM_LEAD_DOT,  // A '.' with no digits before it, so a digit must follow
+  NUM_INT,
+  NUM_FRAC,
+  NUM_EXP,
+  NUM_EXP_SIGN,
+  NUM_EXP_INT,
+  NUM_STATE_COUNT,
+} NumberState;
+
+static const uint8_t number_dfa[NUM_STATE_COUNT][CC_COUNT] = {
+  [NUM_START]    = { [CC_DIGIT] = NUM_INT,     [CC_DOT] = NUM_LEAD_DOT, [CC_SIGN] = NUM_SIGN },
+  [NUM_SIGN]     = { [CC_DIGIT] = NUM_INT,     [CC_DOT] = NUM_LEAD_DOT },
+  [NUM_LEAD_DOT] = { [CC_DIGIT] = NUM_FRAC },
+  [NUM_INT]      = { [CC_DIGIT] = NUM_INT,     [CC_DOT] = NUM_FRAC,     [CC_EXP] = NUM_EXP },
+  [NUM_FRAC]     = { [CC_DIGIT] = NUM_FRAC,    [CC_EXP] = NUM_EXP },
+  [NUM_EXP]      = { [CC_DIGIT] = NUM_EXP_INT, [CC_SIGN] = NUM_EXP_SIGN },
+  [NUM_EXP_SIGN] = { [CC_DIGIT] = NUM_EXP_INT },
+  [NUM_EXP_INT]  = { [CC_DIGIT] = NUM_EXP_INT },
+};
+
+static const TokenType number_accepts[NUM_STATE_COUNT] = {
+  [NUM_INT]     = TOKEN_TYPE_INT,
+  [NUM_FRAC]    = TOKEN_TYPE_FLOAT,
+  [NUM_EXP_INT] = TOKEN_TYPE_FLOAT,
+};
+
+static inline CharClass classify(const Tokeniser *tokeniser, size_t index) {
+  if (index >= tokeniser->contents.length) return CC_OTHER;
+  return char_class[(unsigned char)tokeniser->contents.data[index]];
+}
+
+static const double exact_powers_of_ten[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#define MAX_EXACT_POW10 22
+#define MAX_EXACT_MANTISSA (1ull << 53)
+#define MAX_MANTISSA_DIGITS 19
+
+// Eisel-Lemire: multiplies the normalised mantissa by a 128-bit approximation of 10^exp10 and
+// keeps the top 54 bits. That is enough to round correctly unless the product sits right at a
+// halfway point or the truncated table entry could have carried into the kept bits, which is rare.
+// Returns false in those cases, and for results that are subnormal or out of range.
+static bool eisel_lemire(uint64_t mantissa, int64_t exp10, double *value) {
+  if (exp10 < POW10_TABLE_MIN_EXP || exp10 > POW10_TABLE_MAX_EXP) return false;
+  const uint64_t *power = pow10_table[exp10 - POW10_TABLE_MIN_EXP];
+
+  int clz = __builtin_clzll(mantissa);
+  mantissa <<= clz;
+  // 217706 / 2^16 is just over log2(10)
+  uint64_t exp2 = (uint64_t)(((217706 * exp10) >> 16) + 64 + 1023 - clz);
+
+  uint64_t hi, lo;
+  sdm_mul_64x64(mantissa, power[0], &hi, &lo);
+  // When the bits below the kept ones are all set, the low half of the power may carry into them
+  if ((hi & 0x1FF) == 0x1FF && lo + mantissa < mantissa) {
+    uint64_t low_hi, low_lo;
+    sdm_mul_64x64(mantissa, power[1], &low_hi, &low_lo);
+    uint64_t merged_lo = lo + low_hi;
+    if (merged_lo < lo) hi++;
+    if ((hi & 0x1FF) == 0x1FF && merged_lo + 1 == 0 && low_lo + mantissa < mantissa) return false;
+    lo = merged_lo;
+  }
+
+  uint64_t msb = hi >> 63;
+  uint64_t bits = hi >> (msb + 9);
+  exp2 -= 1 ^ msb;
+  // Exactly halfway between two doubles: the rounding depends on digits this can't see
+  if (lo == 0 && (hi & 0x1FF) == 0 && (bits & 3) == 1) return false;
+
+  // Round the 54 bits to 53, to even
+  bits += bits & 1;
+  bits >>= 1;
+  if (bits >> 53) {
+    bits >>= 1;
+    exp2++;
+  }
+  // Zero means subnormal, 0x7FF and above infinite
+  if (exp2 - 1 >= 0x7FF - 1) return false;
+
+  uint64_t ieee = (exp2 << 52) | (bits & 0x000FFFFFFFFFFFFFull);
+  memcpy(value, &ieee, sizeof(*value));
+  return true;
+}
+
+// Converts mantissa * 10^exp10 to the correctly rounded double. Literals with at most 15-16
+// significant digits and a modest exponent are exact products or quotients of two exactly
+// representable doubles, so one IEEE operation rounds them correctly (Clinger's fast path). Other
+// mantissas of up to 19 digits go through Eisel-Lemire. strtod, on a private copy of the literal,
+// is left for longer mantissas and the few cases Eisel-Lemire can't decide.
+static double number_to_double(uint64_t mantissa, int64_t exp10, bool truncated, const char *text, size_t len) {
+  if (mantissa == 0 && !truncated) return 0.0;
+  if (!truncated && mantissa <= MAX_EXACT_MANTISSA) {
+    if (exp10 >= -MAX_EXACT_POW10 && exp10 < 0) {
+      return (double)mantissa / exact_powers_of_ten[-exp10];
+    }
+    if (exp10 >= 0 && exp10 <= MAX_EXACT_POW10) {
+      return (double)mantissa * exact_powers_of_ten[exp10];
+    }
+    if (exp10 > MAX_EXACT_POW10) {
+      // Something like 1e30: move the surplus power of ten into the mantissa if it stays exact
+      while (exp10 > MAX_EXACT_POW10 && mantissa <= MAX_EXACT_MANTISSA / 10) {
+        mantissa *= 10;
+        exp10--;
+      }
+      if (exp10 <= MAX_EXACT_POW10) {
+        return (double)mantissa * exact_powers_of_ten[exp10];
+      }
+    }
+  }
+  double value;
+  if (!truncated && eisel_lemire(mantissa, exp10, &value)) return value;
+
+  // The sign is applied by the caller
+  if (len > 0 && (text[0] == '-' || text[0] == '+')) {
+    text++;
+    len--;
+  }
+  char local[128];
+  char *copy = (len < sizeof(local)) ? local : malloc(len + 1);
+  if (copy == NULL) {
+    fprintf(stderr, "Memory problem. Aborting.\n");
+    exit(1);
+  }
+  memcpy(copy, text, len);
+  copy[len] = '\0';
+  value = strtod(copy, NULL);
+  if (copy != local) free(copy);
+  return value;
+}
+
+// Scans the longest number starting at the tokeniser position in a single pass over the digits.
+// The number_dfa table drives recognition, and the digits are accumulated into a 64-bit mantissa
+// as they are stepped over. Returns the length of the number, or zero if there isn't one. If
+// token is not NULL, its type and value are filled in. Integers that do not fit into an int64_t
+// are returned as floats.
+size_t tokeniser_scan_number(const Tokeniser *tokeniser, Token *token) {
+  NumberState state = NUM_START;
+  NumberState accepted_state = NUM_REJECT;
+  size_t accepted_len = 0;
+
+  bool negative = false;
+  uint64_t mantissa = 0;
+  int significant_digits = 0;
+  bool truncated = false;
+  int64_t exp10 = 0;
+  bool exp_negative = false;
+  int64_t exp_value = 0;
+
+  const char *text = tokeniser->contents.data + tokeniser->index;
+  for (size_t i=tokeniser->index; ; i++) {
+    CharClass cc = classify(tokeniser, i);
+    NumberState next = number_dfa[state][cc];
+    if (next == NUM_REJECT) break;
+
+    if (cc == CC_DIGIT) {
+      uint64_t digit = tokeniser->contents.data[i] - '0';
+      if (next == NUM_EXP_INT) {
+        if (exp_value < 100000) exp_value = exp_value*10 + digit;
+      } else if (significant_digits < MAX_MANTISSA_DIGITS) {
+        mantissa = mantissa*10 + digit;
+        if (mantissa > 0) significant_digits++;
+        if (next == NUM_FRAC) exp10--;
+      } else {
+        if (digit != 0) truncated = true;
+        if (next == NUM_INT) exp10++;
+      }
+    } else if (cc == CC_SIGN) {
+      if (state == NUM_START) negative = tokeniser->contents.data[i] == '-';
+      else exp_negative = tokeniser->contents.data[i] == '-';
+    }
+
+    state = next;
+    if (number_accepts[state] != TOKEN_TYPE_UNKNOWN) {
+      accepted_len = i - tokeniser->index + 1;
+      accepted_state = state;
+    }
+  }
+
+  if (accepted_len == 0 || token == NULL) return accepted_len;
+
+  TokenType number_type = number_accepts[accepted_state];
+  if (number_type == TOKEN_TYPE_INT && !truncated && exp10 == 0) {
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    if (mantissa <= limit) {
+      token->token_type = TOKEN_TYPE_INT;
+      token->as.int_token.value = negative ? (int64_t)(0 - mantissa) : (int64_t)mantissa;
+      return accepted_len;
+    }
+  }
+
+  if (accepted_state == NUM_EXP_INT) exp10 += exp_negative ? -exp_value : exp_value;
+  double value = number_to_double(mantissa, exp10, truncated, text, accepted_len);
+  token->token_type = TOKEN_TYPE_FLOAT;
+  token->as.float_token.value = negative ? -value : value;
+  return accepted_len;
 }
 
 char tokeniser_current_char(const Tokeniser *tokeniser) {
@@ -100,40 +468,77 @@ bool tokeniser_is_id_char(const Tokeniser *tokeniser) {
     isalnum(tokeniser_current_char(tokeniser));
 }
 
-Token get_next_token(Tokeniser *tokeniser) {
+// Returns a view of len bytes of the contents, copied into the arena unless in zero-copy mode
+static sdm_string_view tokeniser_text(const Tokeniser *tokeniser, size_t start_index, size_t len) {
+  sdm_string_view text = sdm_sized_str_as_sv(&tokeniser->contents.data[start_index], len);
+  if (tokeniser->zero_copy) return text;
+  return sdm_sized_str_as_sv(sdm_sv_to_cstr(text), len);
+}
+
+// The identifier runs from start_index up to the current tokeniser position. In copy mode the
+// value is the interned string, so each distinct name is only copied once.
+static void tokeniser_make_id(Tokeniser *tokeniser, Token *token, size_t start_index) {
+  size_t id_len = tokeniser->index - start_index;
+  sdm_string_view text = sdm_sized_str_as_sv(&tokeniser->contents.data[start_index], id_len);
+  KeyWords kw = keyword_lookup(text.data, id_len);
+  if (kw != KEYWORD_COUNT) {
+    token->token_type = TOKEN_TYPE_KEYWORD;
+    token->as.kw_token.value = kw;
+    return;
+  }
+  sdm_interner *symbols = tokeniser->symbols ? tokeniser->symbols : ll_symbol_table();
+  uint32_t h = sdm_hash_bytes(text.data, id_len);
+  uint32_t symbol = sdm_intern_hashed(symbols, text, h);
+  token->token_type = TOKEN_TYPE_ID;
+  token->as.id_token.symbol = symbol;
+  token->as.id_token.hash = h;
+  token->as.id_token.value = tokeniser->zero_copy ? text : sdm_interner_string(symbols, symbol);
+}
+
+// Expects the tokeniser to be sitting on the opening quotemark.
+static void tokeniser_make_string(Tokeniser *tokeniser, Token *token) {
+  // We have a string.  We have to find the end
+  tokeniser->index++;
+  size_t str_start = tokeniser->index;
+  while ((tokeniser->index < tokeniser->contents.length) && (tokeniser_current_char(tokeniser) != '"')) {
+    tokeniser->index++;
+  }
+  size_t str_len = tokeniser->index - str_start;
+  token->token_type = TOKEN_TYPE_STRING;
+  token->as.str_token.value = tokeniser_text(tokeniser, str_start, str_len);
+  // Step over the closing quotemark, if the string has one
+  if (tokeniser->index < tokeniser->contents.length) tokeniser->index++;
+}
+
+void tokeniser_skip_trivia(Tokeniser *tokeniser) {
   tokeniser_trim(tokeniser);
 
   while (starts_with_comment(*tokeniser)) {
     advance_to_next_line(tokeniser);
     tokeniser_trim(tokeniser);
   };
+}
+
+// Every TOKEN_TYPE_UNKNOWN token comes with this warning
+static void tokeniser_warn_unknown(const Tokeniser *tokeniser, char c) {
+  if (!tokeniser->quiet) fprintf(stderr, "WARNING: Unsure how to parse '%c'\n", c);
+}
+
+Token get_next_token(Tokeniser *tokeniser) {
+  tokeniser_skip_trivia(tokeniser);
 
   Token token = {0};
-  memcpy(&token.source, tokeniser, sizeof(*tokeniser));
+  token.index = tokeniser->index;
   size_t len; // Only valid for the float/int part of the code
 
   if (tokeniser->index >= tokeniser->contents.length) {
     token.token_type = TOKEN_TYPE_EOF;
-  } else if ((len = starts_with_float(*tokeniser)) > 0) {
-    // Could be an integer or a float
-    char *start_ptr = tokeniser->contents.data + tokeniser->index;
-    char *end_ptr = start_ptr;
-    strtol(start_ptr, &end_ptr, 10);
-    if ((end_ptr - start_ptr) == (long)len) {
-      token.token_type = TOKEN_TYPE_INT;
-      token.as.int_token.value = atoi(start_ptr);
-    } else {
-      token.token_type = TOKEN_TYPE_FLOAT;
-      token.as.float_token.value = atof(start_ptr);
-    }
+  } else if ((len = tokeniser_scan_number(tokeniser, &token)) > 0) {
     tokeniser->index += len;
   } else if (tokeniser_isalpha(tokeniser)) {
     size_t start_index = tokeniser->index;
     while (tokeniser_is_id_char(tokeniser)) tokeniser->index++;
-    size_t id_len = tokeniser->index - start_index;
-    token.token_type = TOKEN_TYPE_ID;
-    token.as.id_token.value = SDM_MALLOC((id_len+1) * sizeof(char));
-    memcpy(token.as.id_token.value, &tokeniser->contents.data[start_index], id_len);
+    tokeniser_make_id(tokeniser, &token, start_index);
   } else if (tokeniser_current_char(tokeniser) == ',') {
     token.token_type = TOKEN_TYPE_COMMA;
     tokeniser->index += 1;
@@ -168,20 +573,9 @@ Token get_next_token(Tokeniser *tokeniser) {
     token.token_type = TOKEN_TYPE_CPAREN;
     tokeniser->index += 1;
   } else if (tokeniser_current_char(tokeniser) == '"') {
-    // We have a string.  We have to find the end
-    tokeniser->index++;
-    size_t str_start = tokeniser->index;
-    while ((tokeniser->index < tokeniser->contents.length) && (tokeniser_current_char(tokeniser) != '"')) {
-      tokeniser->index++;
-    }
-    size_t str_len = tokeniser->index - str_start;
-    token.token_type = TOKEN_TYPE_STRING;
-    token.as.str_token.value = SDM_MALLOC(str_len + 1);
-    memset(token.as.str_token.value, 0, str_len + 1);
-    memcpy(token.as.str_token.value, tokeniser->contents.data+str_start, str_len);
-    tokeniser->index += str_len + 1;
+    tokeniser_make_string(tokeniser, &token);
   } else {
-    fprintf(stderr, "WARNING: Unsure how to parse '%c'\n", tokeniser->contents.data[tokeniser->index]);
+    tokeniser_warn_unknown(tokeniser, tokeniser->contents.data[tokeniser->index]);
     token.token_type = TOKEN_TYPE_UNKNOWN;
     tokeniser->index += 1;
   }
@@ -189,144 +583,859 @@ Token get_next_token(Tokeniser *tokeniser) {
   return token;
 }
 
+Token get_next_token_dfa(Tokeniser *tokeniser) {
+  // Skip whitespace and comments. Runs of either are handed to the vectorised scanners.
+  for (;;) {
+    CharClass cc = classify(tokeniser, tokeniser->index);
+    if (cc == CC_SPACE || cc == CC_NEWLINE) {
+      tokeniser_trim(tokeniser);
+    } else if (cc == CC_SLASH && classify(tokeniser, tokeniser->index+1) == CC_SLASH) {
+      advance_to_next_line(tokeniser);
+    } else {
+      break;
+    }
+  }
+
+  Token token = {0};
+  token.index = tokeniser->index;
+
+  if (tokeniser->index >= tokeniser->contents.length) {
+    token.token_type = TOKEN_TYPE_EOF;
+    return token;
+  }
+
+  char c = tokeniser_current_char(tokeniser);
+  switch ((CharClass)char_class[(unsigned char)c]) {
+    case CC_DIGIT:
+    case CC_SIGN:
+    case CC_DOT: {
+      size_t len = tokeniser_scan_number(tokeniser, &token);
+      if (len == 0) {
+        token.token_type = single_char_token[(unsigned char)c];
+        tokeniser->index += 1;
+        break;
+      }
+      tokeniser->index += len;
+    } break;
+    case CC_ALPHA:
+    case CC_EXP: {
+      size_t start_index = tokeniser->index;
+      CharClass cc;
+      do {
+        tokeniser->index++;
+        cc = classify(tokeniser, tokeniser->index);
+      } while (cc == CC_ALPHA || cc == CC_EXP || cc == CC_DIGIT || cc == CC_UNDERSCORE);
+      tokeniser_make_id(tokeniser, &token, start_index);
+    } break;
+    case CC_QUOTE: {
+      tokeniser_make_string(tokeniser, &token);
+    } break;
+    case CC_SLASH:
+    case CC_PUNCT: {
+      token.token_type = single_char_token[(unsigned char)c];
+      tokeniser->index += 1;
+    } break;
+    case CC_OTHER:
+    case CC_UNDERSCORE:
+    case CC_SPACE:
+    case CC_NEWLINE:
+    case CC_COUNT: {
+      tokeniser_warn_unknown(tokeniser, c);
+      token.token_type = TOKEN_TYPE_UNKNOWN;
+      tokeniser->index += 1;
+    } break;
+  }
+
+  return token;
+}
+
+static Token tokeniser_next(Tokeniser *tokeniser) {
+  return (tokeniser->lexer == LEXER_DFA) ? get_next_token_dfa(tokeniser) : get_next_token(tokeniser);
+}
+
+void token_array_attach(TokenArray *t_array, const Tokeniser *tokeniser) {
+  t_array->filename = tokeniser->filename;
+  t_array->contents = tokeniser->contents;
+  t_array->symbols = tokeniser->symbols;
+  if (t_array->lines == NULL) {
+    t_array->lines = SDM_MALLOC(sizeof(*t_array->lines));
+    if (t_array->lines == NULL) {
+      fprintf(stderr, "Memory problem. Aborting.\n");
+      exit(1);
+    }
+  }
+  memset(t_array->lines, 0, sizeof(*t_array->lines));
+}
+
+static void token_array_reserve_for_input(TokenArray *t_array, size_t bytes);
+
 void tokenise_input_file(Tokeniser *tokeniser, TokenArray *token_array) {
   sdm_string_view contents = tokeniser->contents;
+  token_array_attach(token_array, tokeniser);
+  token_array_reserve_for_input(token_array, contents.length - tokeniser->index);
 
   while (tokeniser->index < contents.length) {
-    SDM_ARRAY_PUSH(*token_array, get_next_token(tokeniser));
+    Token token = tokeniser_next(tokeniser);
+    token_array_push(token_array, &token);
   }
 }
 
-void tokeniser_trim(Tokeniser *tokeniser) {
-  char *text = get_current_tokeniser_string(*tokeniser);
-  while (strlen(text) > 0 && isspace(*text)) {
-    if (*text == '\n') {
-      tokeniser->line++;
-      tokeniser->col = 1;
-    } else {
-      tokeniser->col++;
-    }
-    tokeniser->index++;
-    text = get_current_tokeniser_string(*tokeniser);
+bool tokenise_and_validate(Tokeniser *tokeniser, TokenArray *token_array) {
+  sdm_string_view contents = tokeniser->contents;
+  token_array_attach(token_array, tokeniser);
+  token_array_reserve_for_input(token_array, contents.length - tokeniser->index);
+  TokenValidator validator = {0};
+
+  while (tokeniser->index < contents.length) {
+    Token token = tokeniser_next(tokeniser);
+    token_array_push(token_array, &token);
+    if (!token_validator_push(&validator, token_array, token_array->length - 1)) return false;
   }
+  return token_validator_finish(&validator, token_array);
 }
 
-void tokeniser_chop(Tokeniser *tokeniser, size_t len) {
-  sdm_string_view *SV = &tokeniser->contents;
-  for (size_t i=0; SV->length>0 && i<len; i++) {
-    if (SV->data[0] == '\n') {
-      tokeniser->line++;
-      tokeniser->col = 0;
-    } else {
-      tokeniser->col++;
-    }
-    SV->data++;
-    SV->length--;
+// Counts the '\n' bytes in data[start..end)
+static size_t count_newlines(const char *data, size_t start, size_t end) {
+  size_t count = 0;
+  size_t i = start;
+#if defined(__AVX2__)
+  const __m256i nl32 = _mm256_set1_epi8('\n');
+  for (; i + 32 <= end; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+    count += __builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl32)));
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i nl16 = _mm_set1_epi8('\n');
+  for (; i + 16 <= end; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+    count += __builtin_popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl16)));
   }
+#endif
+  for (; i < end; i++) count += data[i] == '\n';
+  return count;
 }
 
-void find_and_apply_keywords(TokenArray *t_array) {
-  for (size_t i=0; i<t_array->length; i++) {
-    if (t_array->data[i].token_type != TOKEN_TYPE_ID)
-      continue;
-    Token *t = &t_array->data[i];
-    for (size_t j=0; j<KEYWORD_COUNT; j++) {
-      if (strcmp(t->as.id_token.value, keyword_strings[j]) == 0) {
-        t->token_type = TOKEN_TYPE_KEYWORD;
-        t->as.kw_token.value = j;
+// Records the start of the line following each '\n' in data[start..end) whose bit is set in mask
+static inline void line_index_push_mask(LineIndex *lines, uint32_t mask, size_t base, size_t length) {
+  while (mask) {
+    size_t line_start = base + __builtin_ctz(mask) + 1;
+    // A newline at the very end doesn't start another line
+    if (line_start < length) SDM_ARRAY_PUSH(*lines, line_start);
+    mask &= mask - 1;
+  }
+}
+
+void line_index_build(LineIndex *lines, sdm_string_view contents) {
+  const char *data = contents.data;
+  size_t length = contents.length;
+  SDM_ARRAY_RESET(*lines);
+  SDM_ARRAY_PUSH(*lines, 0);
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i nl32 = _mm256_set1_epi8('\n');
+  for (; i + 32 <= length; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+    line_index_push_mask(lines, (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl32)), i, length);
+  }
+#endif
+#if defined(__SSE2__)
+  const __m128i nl16 = _mm_set1_epi8('\n');
+  for (; i + 16 <= length; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+    line_index_push_mask(lines, (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl16)), i, length);
+  }
+#endif
+  for (; i < length; i++) {
+    if (data[i] == '\n' && i + 1 < length) SDM_ARRAY_PUSH(*lines, i + 1);
+  }
+}
+
+TokenLocation line_index_resolve(const LineIndex *lines, size_t offset) {
+  assert(lines->length > 0);
+  // Find the last line that starts at or before offset
+  size_t lo = 0;
+  size_t hi = lines->length;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (lines->data[mid] <= offset) lo = mid;
+    else hi = mid;
+  }
+  return (TokenLocation){ .line = lo + 1, .col = offset - lines->data[lo] + 1 };
+}
+
+static_assert(TOKEN_TYPE_COUNT <= UINT8_MAX, "Token types must fit in a byte");
+
+// Grows the three token columns together, copying only the tokens already in them. The literal
+// pools grow on their own as they are pushed to.
+static void token_array_reserve(TokenArray *t_array, size_t min_capacity) {
+  if (t_array->capacity >= min_capacity) return;
+  // The first allocation is exactly what was asked for, so a reserve up front isn't rounded up
+  size_t capacity = (t_array->capacity > 0) ? t_array->capacity : DEFAULT_CAPACITY;
+  if (t_array->capacity == 0 && min_capacity > capacity) capacity = min_capacity;
+  while (capacity < min_capacity) capacity *= 2;
+  size_t length = t_array->length;
+  t_array->types = SDM_REALLOC(t_array->types, length * sizeof(t_array->types[0]), capacity * sizeof(t_array->types[0]));
+  t_array->offsets = SDM_REALLOC(t_array->offsets, length * sizeof(t_array->offsets[0]), capacity * sizeof(t_array->offsets[0]));
+  t_array->payloads = SDM_REALLOC(t_array->payloads, length * sizeof(t_array->payloads[0]), capacity * sizeof(t_array->payloads[0]));
+  if (t_array->types == NULL || t_array->offsets == NULL || t_array->payloads == NULL) {
+    fprintf(stderr, "Memory problem. Aborting.\n");
+    exit(1);
+  }
+  t_array->capacity = capacity;
+}
+
+#define TOKEN_ARRAY_OFFSET_MASK ((UINT64_C(1) << TOKEN_ARRAY_BLOCK_BITS) - 1)
+
+static_assert(TOKEN_ARRAY_BLOCK_BITS <= 32, "Offsets within a block must fit in 32 bits");
+
+// Writes token into slot i, adding its literal to the end of the matching pool
+static void token_array_set(TokenArray *t_array, size_t i, const Token *token) {
+  // Tokens past the first block only ever go on the end, in order, so this is where their block starts
+  while (((uint64_t)token->index >> TOKEN_ARRAY_BLOCK_BITS) > t_array->offset_blocks.length) {
+    SDM_ARRAY_PUSH(t_array->offset_blocks, i);
+  }
+
+  uint32_t payload = 0;
+  switch (token->token_type) {
+    case TOKEN_TYPE_ID: {
+      payload = token->as.id_token.symbol;
+    } break;
+    case TOKEN_TYPE_KEYWORD: {
+      payload = token->as.kw_token.value;
+    } break;
+    case TOKEN_TYPE_INT: {
+      payload = t_array->ints.length;
+      SDM_ARRAY_PUSH(t_array->ints, token->as.int_token.value);
+    } break;
+    case TOKEN_TYPE_FLOAT: {
+      payload = t_array->floats.length;
+      SDM_ARRAY_PUSH(t_array->floats, token->as.float_token.value);
+    } break;
+    case TOKEN_TYPE_STRING: {
+      payload = t_array->strings.length;
+      SDM_ARRAY_PUSH(t_array->strings, token->as.str_token.value);
+    } break;
+    default: break;
+  }
+
+  t_array->types[i] = (uint8_t)token->token_type;
+  t_array->offsets[i] = (uint32_t)(token->index & TOKEN_ARRAY_OFFSET_MASK);
+  t_array->payloads[i] = payload;
+}
+
+// Generated lattices run 4.8 to 5.9 bytes per token, comments and all (5.8 by default, 4.9 with
+// 6-digit floats). Dividing by less than that means the first reservation is nearly always enough.
+#define TOKENISER_BYTES_PER_TOKEN 4
+
+// Reserves enough room that lexing bytes more of the input is unlikely to have to grow the columns.
+// Reserved pages that are never written to cost nothing, so this errs on the large side.
+static void token_array_reserve_for_input(TokenArray *t_array, size_t bytes) {
+  token_array_reserve(t_array, t_array->length + bytes / TOKENISER_BYTES_PER_TOKEN + 1);
+}
+
+void token_array_push(TokenArray *t_array, const Token *token) {
+  token_array_reserve(t_array, t_array->length + 1);
+  token_array_set(t_array, t_array->length, token);
+  t_array->length++;
+}
+
+Token token_array_get(const TokenArray *t_array, size_t i) {
+  assert(i < t_array->length);
+  Token token = {0};
+  token.token_type = t_array->types[i];
+  token.index = token_array_offset(t_array, i);
+  uint32_t payload = t_array->payloads[i];
+  switch (token.token_type) {
+    case TOKEN_TYPE_ID: {
+      sdm_interner *symbols = t_array->symbols ? t_array->symbols : ll_symbol_table();
+      token.as.id_token.symbol = payload;
+      token.as.id_token.hash = sdm_interner_hash(symbols, payload);
+      token.as.id_token.value = sdm_interner_string(symbols, payload);
+    } break;
+    case TOKEN_TYPE_KEYWORD: token.as.kw_token.value = payload; break;
+    case TOKEN_TYPE_INT: token.as.int_token.value = t_array->ints.data[payload]; break;
+    case TOKEN_TYPE_FLOAT: token.as.float_token.value = t_array->floats.data[payload]; break;
+    case TOKEN_TYPE_STRING: token.as.str_token.value = t_array->strings.data[payload]; break;
+    default: break;
+  }
+  return token;
+}
+
+// Positions are only needed for diagnostics, so the line index is built the first time one is asked for
+static const LineIndex *token_array_lines(const TokenArray *t_array) {
+  if (t_array->lines->length == 0) line_index_build(t_array->lines, t_array->contents);
+  return t_array->lines;
+}
+
+TokenLocation token_array_location(const TokenArray *t_array, size_t i) {
+  assert(i < t_array->length);
+  return line_index_resolve(token_array_lines(t_array), token_array_offset(t_array, i));
+}
+
+size_t token_array_line_count(const TokenArray *t_array) {
+  return token_array_lines(t_array)->length;
+}
+
+// Lexing only looks forwards, and a token never starts inside a string or a comment. So lexing from
+// a token that follows whitespace gives the same tokens as lexing from the start of the input. A
+// token that directly follows another might have been part of it, e.g. "1e" + "5".
+static size_t token_edit_restart(const TokenArray *t_array, size_t start) {
+  const uint32_t *offsets = t_array->offsets;
+  size_t lo = 0;
+  size_t hi = t_array->length;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (offsets[mid] < start) lo = mid + 1;
+    else hi = mid;
+  }
+  // lo is the first token at or after the edit. Start from the one before it, in case it runs into
+  // the edit.
+  size_t r = (lo > 0) ? lo - 1 : 0;
+  while (r > 0 && !is_space_byte(t_array->contents.data[offsets[r] - 1])) r--;
+  return r;
+}
+
+void tokenise_edit(Tokeniser *tokeniser, TokenArray *token_array, TokenEdit edit) {
+  const char *old_data = token_array->contents.data;
+  size_t old_end = edit.start + edit.removed;   // End of the edit in the old input
+  size_t new_end = edit.start + edit.inserted;  // End of the edit in the new input
+  size_t length = tokeniser->contents.length;
+  assert(new_end <= length);
+
+  // Shifted tokens could move between blocks, so an input past the first block is lexed again
+  if (((uint64_t)token_array->contents.length >> TOKEN_ARRAY_BLOCK_BITS) || ((uint64_t)length >> TOKEN_ARRAY_BLOCK_BITS)) {
+    token_array->length = 0;
+    SDM_ARRAY_RESET(token_array->ints);
+    SDM_ARRAY_RESET(token_array->floats);
+    SDM_ARRAY_RESET(token_array->strings);
+    SDM_ARRAY_RESET(token_array->offset_blocks);
+    tokeniser->index = 0;
+    tokenise_input_file(tokeniser, token_array);
+    return;
+  }
+
+  size_t first = token_edit_restart(token_array, edit.start);
+  tokeniser->index = (first > 0) ? token_array->offsets[first] : 0;
+
+  // Re-lex until a token starts exactly where an old token from past the edit now starts. The
+  // re-lexed tokens are only needed until they are spliced in, so they go in the scratch arena.
+  sdm_arena_t *scratch = scratch_arena();
+  sdm_arena_mark scratch_mark = sdm_arena_get_mark(scratch);
+  // Most edits only re-lex a few tokens, which fit in the array itself
+  SDM_SMALL_ARRAY(Token, 16) relexed = {0};
+  size_t resync = first;
+  while (resync < token_array->length && token_array->offsets[resync] < old_end) resync++;
+  bool synced = false;
+  while (tokeniser->index < length) {
+    tokeniser_skip_trivia(tokeniser);
+    size_t index = tokeniser->index;
+    if (index >= new_end) {
+      while (resync < token_array->length && token_array->offsets[resync] - old_end + new_end < index) resync++;
+      if (resync < token_array->length && token_array->offsets[resync] - old_end + new_end == index) {
+        synced = true;
         break;
       }
     }
+    Token token = tokeniser_next(tokeniser);
+    sdm_arena_t *previous = swap_active_arena(scratch);
+    SDM_SMALL_ARRAY_PUSH(relexed, token);
+    swap_active_arena(previous);
+  }
+  if (!synced) resync = token_array->length;
+
+  // Replace the tokens [first, resync) with the re-lexed ones and shift the tail into place
+  size_t tail = token_array->length - resync;
+  size_t new_length = first + relexed.length + tail;
+  token_array_reserve(token_array, new_length);
+  size_t to = first + relexed.length;
+  if (tail > 0) {
+    memmove(&token_array->types[to], &token_array->types[resync], tail * sizeof(token_array->types[0]));
+    memmove(&token_array->offsets[to], &token_array->offsets[resync], tail * sizeof(token_array->offsets[0]));
+    memmove(&token_array->payloads[to], &token_array->payloads[resync], tail * sizeof(token_array->payloads[0]));
   }
+  for (size_t i=to; i<new_length; i++) {
+    token_array->offsets[i] = (uint32_t)(token_array->offsets[i] - old_end + new_end);
+  }
+  // Strings from here on are the re-lexed ones, which already point into the new input
+  size_t old_strings = token_array->strings.length;
+  for (size_t i=0; i<relexed.length; i++) {
+    token_array_set(token_array, first + i, &relexed.data[i]);
+  }
+  token_array->length = new_length;
+  sdm_arena_rewind(scratch, scratch_mark);
+
+  // In zero_copy mode string values point into the input, which may have moved. Strings of the
+  // tokens that were replaced are left in the pool, and are no longer referenced. Only the old
+  // strings are rebased: when the input was edited in place, a new one can look like an old one.
+  for (size_t i=0; i<old_strings; i++) {
+    sdm_string_view *value = &token_array->strings.data[i];
+    if (value->data < old_data || value->data >= old_data + token_array->contents.length) continue;
+    size_t offset = value->data - old_data;
+    if (offset >= old_end) offset = offset - old_end + new_end;
+    value->data = tokeniser->contents.data + offset;
+  }
+
+  token_array->contents = tokeniser->contents;
+  token_array->lines->length = 0;
+  tokeniser->index = length;
 }
 
-bool validate_token_array(const TokenArray *t_array) {
-  if (t_array->data[t_array->length-1].token_type != TOKEN_TYPE_EOF) {
-    fprintf(stderr, "Final token should be TOKEN_TYPE_EOF, but is not. This is a bug in the tokeniser.\n");
-    return false;
+// Arena bytes per byte of input for a segment. Segments lex zero-copy, so the arena only holds the
+// token columns, reserved up front at 9 bytes per TOKENISER_BYTES_PER_TOKEN bytes, the number pools
+// and the segment's symbol table. That comes to 3.6-3.9 on generated lattices. This leaves room for
+// denser input, and anything past it chains on another chunk.
+#define TOKENISER_SEGMENT_ARENA_FACTOR 8
+
+typedef struct {
+  Tokeniser tokeniser;
+  size_t end;            // The segment is data[tokeniser.index..end), and ends just after a '\n'
+  bool last;
+  TokenArray tokens;
+  Tokeniser after_last;  // The tokeniser state just after the last token of the segment
+  sdm_interner symbols;
+  sdm_arena_t arena;
+} TokeniserSegment;
+
+// Lexes the tokens that start in [tokeniser->index, end). The last segment runs exactly like
+// tokenise_input_file, so that it produces the EOF token the same way.
+static void tokenise_segment(Tokeniser *tokeniser, size_t end, bool last, TokenArray *token_array, Tokeniser *after_last) {
+  *after_last = *tokeniser;
+  if (last) {
+    while (tokeniser->index < tokeniser->contents.length) {
+      Token token = tokeniser_next(tokeniser);
+      token_array_push(token_array, &token);
+      *after_last = *tokeniser;
+    }
+    return;
   }
-  int parens_balance = 0;
-  for (size_t i=0; i<t_array->length; i++) {
-    Token token = t_array->data[i];
-    if (token.token_type == TOKEN_TYPE_SEMICOLON) {
-      if (parens_balance != 0) {
-        Tokeniser src = token.source;
-        fprintf(stderr, "%s:%zu:%zu: Parenthesis imbalance found\n", src.filename, src.line, src.col);
-        return false;
+  for (;;) {
+    tokeniser_skip_trivia(tokeniser);
+    if (tokeniser->index >= end) return;
+    Token token = tokeniser_next(tokeniser);
+    token_array_push(token_array, &token);
+    *after_last = *tokeniser;
+  }
+}
+
+static void *tokenise_segment_thread(void *arg) {
+  TokeniserSegment *segment = arg;
+  sdm_arena_t *previous = swap_active_arena(&segment->arena);
+  segment->tokeniser.symbols = &segment->symbols;
+  token_array_attach(&segment->tokens, &segment->tokeniser);
+  token_array_reserve_for_input(&segment->tokens, segment->end - segment->tokeniser.index);
+  tokenise_segment(&segment->tokeniser, segment->end, segment->last, &segment->tokens, &segment->after_last);
+  swap_active_arena(previous);
+  return NULL;
+}
+
+// Appends the tokens of a segment lexed on another thread. Its symbols are re-interned into the
+// global table in order of first use, so they get the same numbers as with a single thread. The
+// threads lex quietly, since they may start from the wrong state. Their warnings are printed here
+// instead, once the segment is known to be right, and in file order.
+static void merge_segment(Tokeniser *tokeniser, TokeniserSegment *segment, TokenArray *token_array) {
+  sdm_interner *symbols = tokeniser->symbols ? tokeniser->symbols : ll_symbol_table();
+  size_t symbol_count = segment->symbols.strings.length;
+  uint32_t *symbol_map = malloc(symbol_count * sizeof(symbol_map[0]));
+  if (symbol_map == NULL) {
+    fprintf(stderr, "Memory problem. Aborting.\n");
+    exit(1);
+  }
+  for (size_t i=0; i<symbol_count; i++) symbol_map[i] = UINT32_MAX;
+
+  for (size_t i=0; i<segment->tokens.length; i++) {
+    Token token = token_array_get(&segment->tokens, i);
+    if (token.token_type == TOKEN_TYPE_ID) {
+      uint32_t local = token.as.id_token.symbol;
+      if (symbol_map[local] == UINT32_MAX) {
+        symbol_map[local] = sdm_intern_hashed(symbols, sdm_interner_string(&segment->symbols, local),
+                                              token.as.id_token.hash);
       }
+      token.as.id_token.symbol = symbol_map[local];
+    } else if (token.token_type == TOKEN_TYPE_UNKNOWN) {
+      tokeniser_warn_unknown(tokeniser, segment->tokens.contents.data[token_array_offset(&segment->tokens, i)]);
+    } else if (token.token_type == TOKEN_TYPE_STRING && !tokeniser->zero_copy) {
+      sdm_string_view value = token.as.str_token.value;
+      token.as.str_token.value = sdm_sized_str_as_sv(sdm_sv_to_cstr(value), value.length);
+    }
+    token_array_push(token_array, &token);
+  }
+  free(symbol_map);
+}
+
+size_t tokenise_input_file_parallel(Tokeniser *tokeniser, TokenArray *token_array, size_t thread_count) {
+  size_t start = tokeniser->index;
+  size_t length = tokeniser->contents.length;
+  if (length > start && thread_count > (length - start) / TOKENISER_MIN_SEGMENT) {
+    thread_count = (length - start) / TOKENISER_MIN_SEGMENT;
+  }
+  if (thread_count <= 1) {
+    tokenise_input_file(tokeniser, token_array);
+    return 0;
+  }
+  token_array_attach(token_array, tokeniser);
+
+  // Cut the input just after a newline near each multiple of length/thread_count
+  TokeniserSegment *segments = calloc(thread_count, sizeof(segments[0]));
+  pthread_t *threads = calloc(thread_count, sizeof(threads[0]));
+  if (segments == NULL || threads == NULL) {
+    fprintf(stderr, "Memory problem. Aborting.\n");
+    exit(1);
+  }
+  size_t segment_count = 0;
+  size_t segment_start = start;
+  for (size_t i=0; i<thread_count && segment_start < length; i++) {
+    size_t end = length;
+    if (i + 1 < thread_count) {
+      size_t target = start + (length - start) * (i + 1) / thread_count;
+      if (target < segment_start) target = segment_start;
+      end = find_newline(tokeniser->contents.data, target, length);
+      if (end < length) end++;
+    }
+    TokeniserSegment *segment = &segments[segment_count++];
+    segment->tokeniser = *tokeniser;
+    segment->tokeniser.index = segment_start;
+    segment->tokeniser.zero_copy = true;
+    segment->tokeniser.quiet = true;
+    segment->end = end;
+    segment->last = end >= length;
+    // Size each thread's arena to its segment rather than the default, which is far too big to be
+    // allocating once per thread. It chains on more chunks if this turns out to be too small.
+    segment->arena.capacity = TOKENISER_SEGMENT_ARENA_FACTOR * (end - segment_start);
+    segment_start = end;
+  }
+
+  for (size_t i=0; i<segment_count; i++) {
+    if (pthread_create(&threads[i], NULL, tokenise_segment_thread, &segments[i]) != 0) {
+      fprintf(stderr, "Could not start tokeniser thread: %s\n", strerror(errno));
+      exit(1);
+    }
+  }
+  for (size_t i=0; i<segment_count; i++) pthread_join(threads[i], NULL);
+
+  // Stitch the segments together in order. A segment can only be used as it is if the last token of
+  // the previous one ended before the newline it starts after. Otherwise a string literal ran across
+  // the cut, so the segment was lexed from the wrong state. It is lexed again here instead, carrying
+  // on from the previous segment, and the tokens and warnings from the thread are dropped.
+  size_t total_tokens = token_array->length;
+  for (size_t i=0; i<segment_count; i++) total_tokens += segments[i].tokens.length;
+  token_array_reserve(token_array, total_tokens);
+  Tokeniser cursor = *tokeniser;
+  size_t segment_arena_bytes = 0;
+  for (size_t i=0; i<segment_count; i++) {
+    TokeniserSegment *segment = &segments[i];
+    size_t segment_begin = (i == 0) ? start : segments[i-1].end;
+    if (i == 0 || cursor.index < segment_begin) {
+      merge_segment(tokeniser, segment, token_array);
+      cursor = segment->after_last;
+      cursor.symbols = tokeniser->symbols;
+      cursor.zero_copy = tokeniser->zero_copy;
+      cursor.quiet = tokeniser->quiet;
+    } else {
+      Tokeniser relex = cursor;
+      tokenise_segment(&relex, segment->end, segment->last, token_array, &cursor);
+    }
+    segment_arena_bytes += sdm_arena_used(&segment->arena);
+    sdm_arena_free(&segment->arena);
+  }
+
+  *tokeniser = cursor;
+  if (tokeniser->index < length) {
+    // Only trivia followed the last token. Step over it just as the single-threaded loop would.
+    tokeniser_skip_trivia(tokeniser);
+  }
+
+  free(segments);
+  free(threads);
+  return segment_arena_bytes;
+}
+void token_stream_init(TokenStream *stream, const char *filename, LexerKind lexer, TokenStreamRefill refill, void *context, size_t chunk_size) {
+  memset(stream, 0, sizeof(*stream));
+  stream->capacity = (chunk_size > 0) ? chunk_size : TOKEN_STREAM_DEFAULT_CHUNK;
+  // One spare byte keeps the window NUL-terminated, as the lexers may peek one byte past the end
+  stream->buffer = malloc(stream->capacity + 1);
+  if (stream->buffer == NULL) {
+    fprintf(stderr, "Memory problem. Aborting.\n");
+    exit(1);
+  }
+  stream->buffer[0] = '\0';
+  stream->refill = refill;
+  stream->context = context;
+  stream->tokeniser = (Tokeniser){
+    .filename = filename,
+    .contents = sdm_sized_str_as_sv(stream->buffer, 0),
+    .index = 0,
+    .lexer = lexer,
+    // Values are lexed pointing into the window. token_stream_next gives them somewhere to live
+    // that outlasts a refill, without allocating for every token.
+    .zero_copy = true,
+  };
+}
+
+// Counted the same way as token_array_line_count: a newline at the very end doesn't start a line
+size_t token_stream_line_count(const TokenStream *stream) {
+  return 1 + stream->newlines - (stream->ends_with_newline ? 1 : 0);
+}
+
+void token_stream_free(TokenStream *stream) {
+  SDM_FREE_AND_NULL(stream->buffer);
+  stream->capacity = 0;
+  SDM_FREE_AND_NULL(stream->text);
+  stream->text_capacity = 0;
+}
+
+// Copies a string value out of the window into the stream's text buffer, which is reused
+static sdm_string_view token_stream_keep_text(TokenStream *stream, sdm_string_view value) {
+  if (value.length + 1 > stream->text_capacity) {
+    size_t capacity = (stream->text_capacity > 0) ? stream->text_capacity : DEFAULT_CAPACITY;
+    while (capacity < value.length + 1) capacity *= 2;
+    stream->text = realloc(stream->text, capacity);
+    if (stream->text == NULL) {
+      fprintf(stderr, "Memory problem. Aborting.\n");
+      exit(1);
     }
-    else if (token.token_type == TOKEN_TYPE_OPAREN) parens_balance++;
-    else if (token.token_type == TOKEN_TYPE_CPAREN) parens_balance--;
-    if (parens_balance < 0) {
+    stream->text_capacity = capacity;
+  }
+  memcpy(stream->text, value.data, value.length);
+  stream->text[value.length] = '\0';
+  return sdm_sized_str_as_sv(stream->text, value.length);
+}
+
+// Drops everything before the tokeniser position and reads more input in after what remains.
+// The buffer only grows when a single token (or comment) is bigger than the whole window.
+static void token_stream_fill(TokenStream *stream) {
+  Tokeniser *tokeniser = &stream->tokeniser;
+  size_t keep = tokeniser->contents.length - tokeniser->index;
+  memmove(stream->buffer, stream->buffer + tokeniser->index, keep);
+  stream->consumed += tokeniser->index;
+  tokeniser->index = 0;
+
+  if (keep == stream->capacity) {
+    stream->capacity *= 2;
+    stream->buffer = realloc(stream->buffer, stream->capacity + 1);
+    if (stream->buffer == NULL) {
+      fprintf(stderr, "Memory problem. Aborting.\n");
+      exit(1);
+    }
+  }
+
+  size_t n = stream->refill(stream->context, stream->buffer + keep, stream->capacity - keep);
+  if (n == 0) stream->input_done = true;
+  stream->newlines += count_newlines(stream->buffer, keep, keep + n);
+  if (n > 0) stream->ends_with_newline = stream->buffer[keep + n - 1] == '\n';
+  tokeniser->contents = sdm_sized_str_as_sv(stream->buffer, keep + n);
+  stream->buffer[keep + n] = '\0';
+}
+
+static bool token_stream_has_delimiter(const Tokeniser *tokeniser) {
+  for (size_t i=tokeniser->index+1; i<tokeniser->contents.length; i++) {
+    switch ((CharClass)char_class[(unsigned char)tokeniser->contents.data[i]]) {
+      case CC_SPACE:
+      case CC_NEWLINE:
+      case CC_SLASH:
+      case CC_QUOTE:
+      case CC_PUNCT:
+        return true;
+      case CC_OTHER:
+      case CC_ALPHA:
+      case CC_EXP:
+      case CC_DIGIT:
+      case CC_UNDERSCORE:
+      case CC_SIGN:
+      case CC_DOT:
+      case CC_COUNT:
+        break;
+    }
+  }
+  return false;
+}
+
+bool token_stream_next(TokenStream *stream, Token *token) {
+  Tokeniser *tokeniser = &stream->tokeniser;
+  for (;;) {
+    if (tokeniser->index >= tokeniser->contents.length) {
+      if (stream->input_done) return false;
+      token_stream_fill(stream);
+      continue;
+    }
+
+    // Whitespace or a comment running into the end of the window might carry on in the next chunk
+    Tokeniser saved = *tokeniser;
+    tokeniser_skip_trivia(tokeniser);
+    if (!stream->input_done && tokeniser->index >= tokeniser->contents.length) {
+      *tokeniser = saved;
+      token_stream_fill(stream);
+      continue;
+    }
+
+    // Identifiers and numbers can't run past whitespace or punctuation. If there is some after the
+    // start of the token, the token is complete within the window, and identifiers are never
+    // interned from a partial name. String literals are checked after lexing.
+    if (!stream->input_done && !token_stream_has_delimiter(tokeniser)) {
+      *tokeniser = saved;
+      token_stream_fill(stream);
+      continue;
+    }
+
+    Token t = tokeniser_next(tokeniser);
+    if (!stream->input_done && tokeniser->index >= tokeniser->contents.length) {
+      // A string literal that hasn't been closed yet
+      *tokeniser = saved;
+      token_stream_fill(stream);
+      continue;
+    }
+
+    if (t.token_type == TOKEN_TYPE_ID) {
+      const sdm_interner *symbols = tokeniser->symbols ? tokeniser->symbols : ll_symbol_table();
+      t.as.id_token.value = sdm_interner_string(symbols, t.as.id_token.symbol);
+    } else if (t.token_type == TOKEN_TYPE_STRING) {
+      t.as.str_token.value = token_stream_keep_text(stream, t.as.str_token.value);
+    }
+    t.index += stream->consumed;
+    *token = t;
+    return true;
+  }
+}
+
+size_t token_stream_read_file(void *context, char *buffer, size_t capacity) {
+  FILE *f = context;
+  size_t n = fread(buffer, 1, capacity, f);
+  if (n == 0 && ferror(f)) {
+    fprintf(stderr, "Could not read input stream: %s\n", strerror(errno));
+    exit(1);
+  }
+  return n;
+}
+
+size_t token_stream_read_fd(void *context, char *buffer, size_t capacity) {
+  int fd = *(int*)context;
+  for (;;) {
+    ssize_t n = read(fd, buffer, capacity);
+    if (n >= 0) return (size_t)n;
+    if (errno == EINTR) continue;
+    fprintf(stderr, "Could not read input stream: %s\n", strerror(errno));
+    exit(1);
+  }
+}
+
+void tokeniser_trim(Tokeniser *tokeniser) {
+  tokeniser->index = skip_whitespace(tokeniser->contents.data, tokeniser->index, tokeniser->contents.length);
+}
+
+// Prints "file:line:col: " for the token at index i, ahead of a diagnostic
+static void print_token_position(const TokenArray *t_array, size_t i) {
+  TokenLocation loc = token_array_location(t_array, i);
+  fprintf(stderr, "%s:%zu:%zu: ", t_array->filename, loc.line, loc.col);
+}
+
+static const TokenType let_shape[] = {
+  TOKEN_TYPE_ID, TOKEN_TYPE_COLON, TOKEN_TYPE_ID, TOKEN_TYPE_ASSIGNMENT,
+};
+
+bool token_validator_push(TokenValidator *validator, const TokenArray *t_array, size_t i) {
+  TokenType type = t_array->types[i];
+  if (type == TOKEN_TYPE_SEMICOLON) {
+    if (validator->parens_balance != 0) {
+      print_token_position(t_array, i);
       fprintf(stderr, "Parenthesis imbalance found\n");
       return false;
     }
   }
+  else if (type == TOKEN_TYPE_OPAREN) validator->parens_balance++;
+  else if (type == TOKEN_TYPE_CPAREN) validator->parens_balance--;
+  if (validator->parens_balance < 0) {
+    fprintf(stderr, "Parenthesis imbalance found\n");
+    return false;
+  }
 
-  size_t ind = 0;
-  while (ind < t_array->length) {
-    Token this_token = t_array->data[ind];
-    if (this_token.token_type == TOKEN_TYPE_EOF) return true;
-    assert(ind < t_array->length-1);
-    switch (this_token.token_type) {
-      case TOKEN_TYPE_KEYWORD: {
-        KeyWords kw = this_token.as.kw_token.value;
-        switch (kw) {
-          case KEYWORD_LET: {
-            if (t_array->length - ind < 5) {
-              fprintf(stderr, "%s:%zu:%zu: ERROR: 'let' expression badly formed\n",
-                      this_token.source.filename, this_token.source.line, this_token.source.col);
-              return false;
-            }
-            if (
-              t_array->data[ind+1].token_type!=TOKEN_TYPE_ID || 
-              t_array->data[ind+2].token_type!=TOKEN_TYPE_COLON || 
-              t_array->data[ind+3].token_type!=TOKEN_TYPE_ID || 
-              t_array->data[ind+4].token_type!=TOKEN_TYPE_ASSIGNMENT
-            ) {
-              fprintf(stderr, "%s:%zu:%zu: ERROR: 'let' expression badly formed. Should be 'let name: type = expr'\n",
-                      this_token.source.filename, this_token.source.line, this_token.source.col);
+  switch (validator->state) {
+    case VALIDATOR_STATEMENT: {
+      switch (type) {
+        case TOKEN_TYPE_KEYWORD: {
+          KeyWords kw = t_array->payloads[i];
+          switch (kw) {
+            case KEYWORD_LET: {
+              validator->state = VALIDATOR_LET;
+              validator->let_index = i;
+              validator->let_tokens = 0;
+              validator->let_ok = true;
+            } break;
+            case KEYWORD_COUNT: {
+              print_token_position(t_array, i);
+              fprintf(stderr, "Unknown keyword. This is a bug in the tokeniser.\n");
               return false;
             }
-            ind += 5;
-            while (t_array->data[ind].token_type != TOKEN_TYPE_SEMICOLON && t_array->data[ind].token_type != TOKEN_TYPE_EOF) {
-              ind += 1;
-            }
-          } break;
-          case KEYWORD_COUNT: {
-            fprintf(stderr, "%s:%zu:%zu: Unknown keyword. This is a bug in the tokeniser.\n", this_token.source.filename, this_token.source.line, this_token.source.col);
-            return false;
           }
+        } break;
+        case TOKEN_TYPE_EOF: {
+          validator->state = VALIDATOR_DONE;
+        } break;
+        case TOKEN_TYPE_SEMICOLON: break;
+        case TOKEN_TYPE_ID:
+        case TOKEN_TYPE_UNKNOWN:
+        case TOKEN_TYPE_FLOAT:
+        case TOKEN_TYPE_INT:
+        case TOKEN_TYPE_STRING:
+        case TOKEN_TYPE_ASSIGNMENT:
+        case TOKEN_TYPE_ADD:
+        case TOKEN_TYPE_MULT:
+        case TOKEN_TYPE_SUB:
+        case TOKEN_TYPE_DIV:
+        case TOKEN_TYPE_OPAREN:
+        case TOKEN_TYPE_CPAREN:
+        case TOKEN_TYPE_COLON:
+        case TOKEN_TYPE_COMMA:
+        case TOKEN_TYPE_POINT:
+        case TOKEN_TYPE_QUOTEMARK:
+        case TOKEN_TYPE_COUNT: {
+          print_token_position(t_array, i);
+          fprintf(stderr, "Error\n");
+          return false;
         }
-      } break;
-      case TOKEN_TYPE_EOF: return true;
-      case TOKEN_TYPE_SEMICOLON: {
-        ind += 1;
-        continue;
       }
-      case TOKEN_TYPE_ID:
-      case TOKEN_TYPE_UNKNOWN:
-      case TOKEN_TYPE_FLOAT:
-      case TOKEN_TYPE_INT:
-      case TOKEN_TYPE_STRING:
-      case TOKEN_TYPE_ASSIGNMENT:
-      case TOKEN_TYPE_ADD:
-      case TOKEN_TYPE_MULT:
-      case TOKEN_TYPE_SUB:
-      case TOKEN_TYPE_DIV:
-      case TOKEN_TYPE_OPAREN:
-      case TOKEN_TYPE_CPAREN:
-      case TOKEN_TYPE_COLON:
-      case TOKEN_TYPE_COMMA:
-      case TOKEN_TYPE_POINT:
-      case TOKEN_TYPE_QUOTEMARK:
-      case TOKEN_TYPE_COUNT: {
-        fprintf(stderr, "%s:%zu:%zu: Error\n", this_token.source.filename, this_token.source.line, this_token.source.col);
+    } break;
+    case VALIDATOR_LET: {
+      // The message depends on whether the input ends before the shape is complete, so a mismatch
+      // is only reported once all four tokens (or the EOF) have been seen
+      size_t n = validator->let_tokens++;
+      if (type == TOKEN_TYPE_EOF && n + 1 < SDM_ARRAY_LENGTH(let_shape)) {
+        print_token_position(t_array, validator->let_index);
+        fprintf(stderr, "ERROR: 'let' expression badly formed\n");
         return false;
       }
-    }
+      if (type != let_shape[n]) validator->let_ok = false;
+      if (n + 1 == SDM_ARRAY_LENGTH(let_shape)) {
+        if (!validator->let_ok) {
+          print_token_position(t_array, validator->let_index);
+          fprintf(stderr, "ERROR: 'let' expression badly formed. Should be 'let name: type = expr'\n");
+          return false;
+        }
+        validator->state = VALIDATOR_SKIP;
+      }
+    } break;
+    case VALIDATOR_SKIP: {
+      if (type == TOKEN_TYPE_SEMICOLON) validator->state = VALIDATOR_STATEMENT;
+      else if (type == TOKEN_TYPE_EOF) validator->state = VALIDATOR_DONE;
+    } break;
+    case VALIDATOR_DONE: break;
   }
+  return true;
+}
 
+bool token_validator_finish(const TokenValidator *validator, const TokenArray *t_array) {
+  if (t_array->length == 0 || t_array->types[t_array->length-1] != TOKEN_TYPE_EOF) {
+    fprintf(stderr, "Final token should be TOKEN_TYPE_EOF, but is not. This is a bug in the tokeniser.\n");
+    return false;
+  }
+  assert(validator->state == VALIDATOR_DONE);
+  (void)validator;
   return true;
 }
 
+bool validate_token_array(const TokenArray *t_array) {
+  TokenValidator validator = {0};
+  for (size_t i=0; i<t_array->length; i++) {
+    if (!token_validator_push(&validator, t_array, i)) return false;
+  }
+  return token_validator_finish(&validator, t_array);
+}
@@ -7,12 +7,19 @@
 
 #define SDM_ARRAY_LENGTH(array) sizeof((array)) / sizeof((array[0]))
 
+typedef enum {
+  LEXER_LADDER = 0,
+  LEXER_DFA,
+} LexerKind;
+
 typedef struct {
   const char *filename;
   sdm_string_view contents;
-  size_t line;
-  size_t col;
   size_t index;
+  LexerKind lexer;
+  bool zero_copy;
+  sdm_interner *symbols;  // Where identifiers are interned. NULL means the global ll_symbol_table()
+  bool quiet;             // Don't print warnings. The TOKEN_TYPE_UNKNOWN tokens still record where they were.
 } Tokeniser;
 
 typedef enum {
@@ -40,17 +47,46 @@ typedef enum {
 
 extern char *TT_string[];
 
+// Every keyword as (enum name, text, first character, last character). The lexer recognises them
+// with a perfect hash of the length and the first and last characters, see keyword_table.
+#define LL_KEYWORDS(X) \
+  X(KEYWORD_LET, "let", 'l', 't')
+
 typedef enum {
-  KEYWORD_LET = 0,
+#define X(name, text, first, last) name,
+  LL_KEYWORDS(X)
+#undef X
   KEYWORD_COUNT,
 } KeyWords;
 
-typedef struct { char *value; } IDToken;
+extern const char *keyword_strings[];
+
+// The value of an ID or string token is a NUL-terminated copy of the text, unless the tokeniser is
+// in zero_copy mode. Then it points straight into the tokeniser contents and is not NUL-terminated.
+// Use sdm_sv_to_cstr to get an owned copy when one is needed.
+// Every identifier is also interned in the global symbol table. Its symbol is the same for each
+// occurrence of the name. Keywords are recognised as they are lexed and are never interned.
+// The hash is sdm_hash_bytes of the name (truncated to 32 bits). It is computed once, when the
+// identifier is scanned, and kept by the symbol table, so nothing has to hash the name again.
+typedef struct { sdm_string_view value; uint32_t symbol; uint32_t hash; } IDToken;
 typedef struct { double value; } FloatToken;
 typedef struct { int64_t value; } IntToken;
-typedef struct { char *value; } StringToken;
+typedef struct { sdm_string_view value; } StringToken;
 typedef struct { KeyWords value; } KeyWordToken;
 
+// The tokeniser only tracks byte offsets. Lines and columns are only needed for diagnostics, so they
+// are looked up in an index of line starts, which is built with one scan for newlines.
+typedef struct {
+  size_t line;
+  size_t col;
+} TokenLocation;
+
+// data[n] is the offset of the first byte of line n+1
+typedef SDM_ARRAY(size_t) LineIndex;
+
+void line_index_build(LineIndex *lines, sdm_string_view contents);
+TokenLocation line_index_resolve(const LineIndex *lines, size_t offset);
+
 typedef struct {
   TokenType token_type;
   union {
@@ -60,25 +96,138 @@ typedef struct {
     StringToken str_token;
     KeyWordToken kw_token;
   } as;
-  Tokeniser source;
+  size_t index;  // Byte offset of the start of the token in the tokeniser contents
 } Token;
 
+// Tokens are stored column-wise so that walking the types of a large input stays in cache. Each token
+// has a type, the offset of its first byte in contents, and a payload. The payload of an ID is its
+// symbol, of a keyword its KeyWords value, and of an int, float or string its index in the matching
+// pool. Line and column aren't stored, they are worked out from the offset when needed. ID values
+// read back with token_array_get come from the symbol table, even in zero_copy mode.
+// Offsets are kept in 32 bits. Inputs past 4GB are split into blocks of 2^TOKEN_ARRAY_BLOCK_BITS
+// bytes, and offset_blocks.data[k] is the index of the first token that starts past block k. Read
+// offsets with token_array_offset, which adds the start of the token's block back on.
+#ifndef TOKEN_ARRAY_BLOCK_BITS
+#define TOKEN_ARRAY_BLOCK_BITS 32
+#endif
 typedef struct {
+  const char *filename;
+  sdm_string_view contents;
+  sdm_interner *symbols;  // The table ID payloads refer to. NULL means the global ll_symbol_table()
   size_t capacity;
   size_t length;
-  Token *data;
+  uint8_t *types;
+  uint32_t *offsets;      // Relative to the start of the token's block
+  uint32_t *payloads;
+  SDM_ARRAY(int64_t) ints;
+  SDM_ARRAY(double) floats;
+  sdm_sv_array strings;
+  LineIndex *lines;       // Built the first time a location is asked for
+  SDM_ARRAY(size_t) offset_blocks;  // Empty unless the input is past the first block
 } TokenArray;
 
-void find_and_apply_keywords(TokenArray *t_array);
+static inline size_t token_array_offset(const TokenArray *t_array, size_t i) {
+  uint64_t block = 0;
+  while (block < t_array->offset_blocks.length && t_array->offset_blocks.data[block] <= i) block++;
+  return (size_t)((block << TOKEN_ARRAY_BLOCK_BITS) + t_array->offsets[i]);
+}
+
+// Points the array at the filename, input and symbol table of the tokeniser. The tokenise functions
+// do this themselves.
+void token_array_attach(TokenArray *t_array, const Tokeniser *tokeniser);
+void token_array_push(TokenArray *t_array, const Token *token);
+Token token_array_get(const TokenArray *t_array, size_t i);
+TokenLocation token_array_location(const TokenArray *t_array, size_t i);
+size_t token_array_line_count(const TokenArray *t_array);
+
+sdm_interner *ll_symbol_table(void);
+
+// Pulls tokens from input that arrives in chunks, e.g. from a pipe, using a fixed-size window.
+// refill reads up to capacity bytes into buffer and returns how many it read, or zero at the end
+// of the input. Tokens that straddle two chunks are carried over. The index of each token is its
+// offset from the start of the stream. Memory use doesn't grow with the input: the value of a string
+// token is kept in a buffer of the stream's, and only stays valid until the next token is pulled.
+// Identifiers are interned as usual, so their values last.
+typedef size_t (*TokenStreamRefill)(void *context, char *buffer, size_t capacity);
+
+#define TOKEN_STREAM_DEFAULT_CHUNK 64 * 1024
+
+typedef struct {
+  Tokeniser tokeniser;   // contents is the part of the input currently in the window
+  char *buffer;
+  size_t capacity;
+  size_t consumed;       // Bytes of the stream that have been dropped from the window
+  TokenStreamRefill refill;
+  void *context;
+  bool input_done;
+  size_t newlines;       // Newlines read from the input so far
+  bool ends_with_newline;
+  char *text;            // The NUL-terminated value of the last string token
+  size_t text_capacity;
+} TokenStream;
+
+void token_stream_init(TokenStream *stream, const char *filename, LexerKind lexer, TokenStreamRefill refill, void *context, size_t chunk_size);
+bool token_stream_next(TokenStream *stream, Token *token);
+void token_stream_free(TokenStream *stream);
+size_t token_stream_line_count(const TokenStream *stream);
+size_t token_stream_read_file(void *context, char *buffer, size_t capacity); // context is a FILE*
+size_t token_stream_read_fd(void *context, char *buffer, size_t capacity);   // context is an int* fd
+
+// Checks the structure of the token stream one token at a time, so that it can run as tokens are
+// lexed. Push each token right after it is added to the array. Both calls print a diagnostic and
+// return false at the first error.
+typedef enum {
+  VALIDATOR_STATEMENT = 0,  // Expecting the start of a statement
+  VALIDATOR_LET,            // Checking the 'let name: type =' part of a let statement
+  VALIDATOR_SKIP,           // Skipping to the ';' that ends the statement
+  VALIDATOR_DONE,           // Seen the EOF token
+} TokenValidatorState;
+
+typedef struct {
+  TokenValidatorState state;
+  int parens_balance;
+  size_t let_index;   // The 'let' being checked
+  size_t let_tokens;  // How many tokens after it have been seen
+  bool let_ok;
+} TokenValidator;
+
+bool token_validator_push(TokenValidator *validator, const TokenArray *t_array, size_t i);
+bool token_validator_finish(const TokenValidator *validator, const TokenArray *t_array);
 bool validate_token_array(const TokenArray *t_array);
 
 bool starts_with_comment(Tokeniser tokeniser);
-size_t starts_with_float(Tokeniser tokeniser);
+size_t tokeniser_scan_number(const Tokeniser *tokeniser, Token *token);
 Token get_next_token(Tokeniser *tokeniser);
+Token get_next_token_dfa(Tokeniser *tokeniser);
 void tokenise_input_file(Tokeniser *tokeniser, TokenArray *token_array);
+// Lexes and validates in the same pass, stopping at the first error
+bool tokenise_and_validate(Tokeniser *tokeniser, TokenArray *token_array);
+
+// The bytes [start, start+removed) of the input were replaced by inserted new bytes
+typedef struct {
+  size_t start;
+  size_t removed;
+  size_t inserted;
+} TokenEdit;
+
+// Brings token_array, lexed from the old input, up to date after an edit. tokeniser->contents must
+// be the edited input. Lexing restarts at a token shortly before the edit and stops as soon as a
+// token starts where one of the old tokens after the edit would now start. From there on the old
+// tokens are kept, with their offsets shifted. The result is the same as lexing the whole input again.
+void tokenise_edit(Tokeniser *tokeniser, TokenArray *token_array, TokenEdit edit);
+
+// Splits the input at newlines into up to thread_count segments and lexes them concurrently. The
+// result is identical to tokenise_input_file, including symbols and line numbers. Segments are
+// never smaller than TOKENISER_MIN_SEGMENT bytes, so small inputs are lexed on the calling thread.
+// Returns the bytes the segments used in their own arenas, which are freed before it returns.
+#ifndef TOKENISER_MIN_SEGMENT
+#define TOKENISER_MIN_SEGMENT 64 * 1024
+#endif
+size_t tokenise_input_file_parallel(Tokeniser *tokeniser, TokenArray *token_array, size_t thread_count);
+void tokeniser_skip_trivia(Tokeniser *tokeniser);
 void tokeniser_trim(Tokeniser *tokeniser);
-void tokeniser_chop(Tokeniser *tokeniser, size_t len);
-void print_token_array(TokenArray token_array);
+void print_token(Token t);
+void print_token_array(const TokenArray *t_array);
 
 #endif // !_LL_LIB_H
 
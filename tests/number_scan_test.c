@@ -0,0 +1,126 @@
+// Checks the values tokeniser_scan_number gives against strtod and strtoll.
+// Usage: number_scan_test [LITERALS]
+//
+// The scanner converts most floats itself, by the exact fast path or by Eisel-Lemire, and only falls
+// back on strtod for the rest. Every float has to come out bit-identical to strtod, and every int
+// identical to strtoll, with ints that overflow an int64_t turned into floats. The literals are
+// random mantissas of 1 to 25 digits with random exponents, the shortest round-trip forms of random
+// doubles, and a list of known hard cases.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_arena.h"
+#include "token_lib.h"
+
+#define DEFAULT_LITERALS 1000000
+#define LITERAL_SIZE 512
+
+static const char *edge_cases[] = {
+  "0", "0.0", "-0.0", "0e0", "1e-400", "1e400", "-1e400", "0.1", "0.2", "0.30000000000000004", "1e23",
+  "9007199254740992.0", "9007199254740993.0", "9007199254740992.5", "9007199254740993.5",
+  "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308",
+  "2.2250738585072014e-308", "2.2250738585072011e-308", "2.2250738585072012e-308",
+  "4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324",
+  "8.98846567431158e307", "7.2057594037927933e16", "12345678901234567890.0",
+  "9223372036854775807", "9223372036854775808", "-9223372036854775808", "-9223372036854775809",
+  "18446744073709551615", "18446744073709551616", "99999999999999999999",
+  "123456789012345678901234567890e-10", "0.000000000000000000000000000001e30",
+  "1.00000000000000011102230246251565404236316680908203125",
+  "1.00000000000000011102230246251565404236316680908203124",
+  "1.00000000000000011102230246251565404236316680908203126",
+};
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint64_t rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static size_t checked = 0;
+static size_t failures = 0;
+
+static void fail(const char *text, const char *reason, double got, double want) {
+  if (failures++ < 10) fprintf(stderr, "FAIL: %s: %s, got %.17g, want %.17g\n", text, reason, got, want);
+}
+
+static void check(const char *text) {
+  Tokeniser tokeniser = { .contents = sdm_cstr_as_sv((char *)text) };
+  Token token = {0};
+  size_t length = tokeniser_scan_number(&tokeniser, &token);
+  checked++;
+  if (length != strlen(text)) {
+    fail(text, "scanned the wrong length", (double)length, (double)strlen(text));
+    return;
+  }
+
+  bool integer = strpbrk(text, ".eE") == NULL;
+  if (integer) {
+    errno = 0;
+    long long want = strtoll(text, NULL, 10);
+    if (errno != ERANGE) {
+      if (token.token_type != TOKEN_TYPE_INT) fail(text, "an int that fits was not an int", 0, (double)want);
+      else if (token.as.int_token.value != want) fail(text, "wrong int", (double)token.as.int_token.value, (double)want);
+      return;
+    }
+  }
+  double want = strtod(text, NULL);
+  if (token.token_type != TOKEN_TYPE_FLOAT) {
+    fail(text, "not a float", 0, want);
+    return;
+  }
+  double got = token.as.float_token.value;
+  if (memcmp(&got, &want, sizeof(double)) != 0) fail(text, "wrong float", got, want);
+}
+
+// A random mantissa of 1 to 25 digits, with or without a fraction and an exponent
+static void random_literal(char *text) {
+  size_t n = 0;
+  if (rng_next() & 1) text[n++] = '-';
+  size_t digits = 1 + rng_next() % 25;
+  size_t point = (rng_next() & 1) ? rng_next() % digits : digits;
+  for (size_t d=0; d<digits; d++) {
+    if (d == point && d > 0) text[n++] = '.';
+    text[n++] = '0' + rng_next() % 10;
+  }
+  if (rng_next() & 1) {
+    snprintf(text + n, LITERAL_SIZE - n, "e%d", (int)(rng_next() % 700) - 350);
+  } else {
+    text[n] = '\0';
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t count = (argc > 1) ? strtoull(argv[1], NULL, 10) : DEFAULT_LITERALS;
+  for (size_t i=0; i<sizeof(edge_cases)/sizeof(edge_cases[0]); i++) check(edge_cases[i]);
+
+  char text[LITERAL_SIZE];
+  for (size_t i=0; i<count; i++) {
+    random_literal(text);
+    check(text);
+
+    // The shortest text that reads back as a random double, which is right next to a halfway point
+    uint64_t bits = rng_next();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    if (value != value || value - value != 0) continue;
+    snprintf(text, sizeof(text), "%.17g", value);
+    check(text);
+  }
+
+  // A mantissa longer than the scanner keeps, so the digits it drops decide the rounding
+  for (size_t digits=20; digits<=400; digits+=20) {
+    for (size_t d=0; d<digits; d++) text[d] = '0' + (d == 0 ? 1 + rng_next() % 9 : rng_next() % 10);
+    snprintf(text + digits, sizeof(text) - digits, "e-%zu", digits + rng_next() % 300);
+    check(text);
+  }
+
+  printf("number_scan: %zu literals, %zu failures\n", checked, failures);
+  app_arena_free();
+  return failures > 0;
+}
@@ -0,0 +1,148 @@
+// Checks tokenise_edit against lexing the whole edited input again.
+// Usage: tokenise_edit_test [EDITS]
+//
+// Builds random inputs out of fragments that tend to sit on token boundaries (numbers that may grow
+// an exponent, strings that may lose their closing quote, comments that may swallow a line), then
+// applies random edits one after another. Each edit is made either in place, as an editor buffer
+// would, or by copying into a new buffer, with and without zero_copy. After every edit the array
+// must hold exactly the tokens, offsets and values a full re-lex gives.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_arena.h"
+#include "token_lib.h"
+
+#define DEFAULT_EDITS 20000
+#define EDITS_PER_INPUT 20
+#define INPUT_CAPACITY 4096
+#define MAX_FRAGMENTS 24
+
+static const char *fragments[] = {
+  "let ", "x", "abc", "_y2", "1", "42", "1e", "5", "2.5", "e-3", ".", "\"", "hi", "\" ", "//",
+  "// note\n", "\n", " ", "\t", "+", "-", "*", "/", "(", ")", ";", ":", "=", ",", "#", "let",
+};
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t rng_next(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static size_t rng_below(size_t n) { return n ? rng_next() % n : 0; }
+
+// Appends up to max_fragments random fragments at text, returning how many bytes were written
+static size_t random_text(char *text, size_t room, size_t max_fragments) {
+  size_t length = 0;
+  size_t count = rng_below(max_fragments + 1);
+  for (size_t i=0; i<count; i++) {
+    const char *fragment = fragments[rng_below(sizeof(fragments) / sizeof(fragments[0]))];
+    size_t n = strlen(fragment);
+    if (length + n > room) break;
+    memcpy(text + length, fragment, n);
+    length += n;
+  }
+  return length;
+}
+
+static bool same_token(const TokenArray *got, const TokenArray *want, size_t i) {
+  Token a = token_array_get(got, i);
+  Token b = token_array_get(want, i);
+  if (a.token_type != b.token_type || a.index != b.index) return false;
+  switch (a.token_type) {
+    case TOKEN_TYPE_ID: return a.as.id_token.symbol == b.as.id_token.symbol;
+    case TOKEN_TYPE_INT: return a.as.int_token.value == b.as.int_token.value;
+    case TOKEN_TYPE_FLOAT: return memcmp(&a.as.float_token.value, &b.as.float_token.value, sizeof(double)) == 0;
+    case TOKEN_TYPE_STRING: return sdm_sv_compare(a.as.str_token.value, b.as.str_token.value);
+    case TOKEN_TYPE_KEYWORD: return a.as.kw_token.value == b.as.kw_token.value;
+    default: return true;
+  }
+}
+
+// Returns the index of the first token that differs, or SIZE_MAX if the arrays are the same
+static size_t first_difference(const TokenArray *got, const TokenArray *want) {
+  size_t length = got->length < want->length ? got->length : want->length;
+  for (size_t i=0; i<length; i++) {
+    if (!same_token(got, want, i)) return i;
+  }
+  return got->length == want->length ? SIZE_MAX : length;
+}
+
+int main(int argc, char **argv) {
+  size_t edit_count = (argc > 1) ? strtoull(argv[1], NULL, 10) : DEFAULT_EDITS;
+  // One spare byte keeps the input NUL-terminated, as the lexers may peek one byte past the end
+  char *buffer = malloc(INPUT_CAPACITY + 1);
+  char *inserted = malloc(INPUT_CAPACITY);
+  size_t failures = 0;
+
+  for (size_t done=0; done<edit_count;) {
+    sdm_arena_mark mark = sdm_arena_get_mark(&main_arena);
+    bool zero_copy = rng_below(2);
+    bool in_place = rng_below(2);
+    sdm_interner symbols = {0};
+    size_t length = random_text(buffer, INPUT_CAPACITY / 2, 4 * MAX_FRAGMENTS);
+    buffer[length] = '\0';
+    char *data = buffer;
+    Tokeniser tokeniser = {
+      .filename = "edit",
+      .contents = sdm_sized_str_as_sv(data, length),
+      .zero_copy = zero_copy,
+      .symbols = &symbols,
+      .quiet = true,
+    };
+    TokenArray t_array = {0};
+    tokenise_input_file(&tokeniser, &t_array);
+
+    for (size_t e=0; e<EDITS_PER_INPUT && done<edit_count; e++, done++) {
+      TokenEdit edit = { .start = rng_below(length + 1) };
+      edit.removed = rng_below(length - edit.start + 1) % 16;
+      edit.inserted = random_text(inserted, INPUT_CAPACITY - length, 3);
+      size_t new_length = length - edit.removed + edit.inserted;
+
+      // In place, the input moves within the same buffer. Otherwise it is copied into a new one and
+      // the old one is poisoned, so that anything still pointing at it shows up as a mismatch.
+      char *new_data = in_place ? data : malloc(INPUT_CAPACITY + 1);
+      if (!in_place) memcpy(new_data, data, edit.start);
+      memmove(new_data + edit.start + edit.inserted, data + edit.start + edit.removed,
+              length - edit.start - edit.removed);
+      memcpy(new_data + edit.start, inserted, edit.inserted);
+      new_data[new_length] = '\0';
+      if (!in_place) {
+        memset(data, '?', length);
+        if (data != buffer) free(data);
+      }
+      data = new_data;
+      length = new_length;
+
+      tokeniser.contents = sdm_sized_str_as_sv(data, length);
+      tokenise_edit(&tokeniser, &t_array, edit);
+
+      Tokeniser full_tokeniser = tokeniser;
+      full_tokeniser.index = 0;
+      TokenArray full = {0};
+      tokenise_input_file(&full_tokeniser, &full);
+      size_t i = first_difference(&t_array, &full);
+      if (i != SIZE_MAX) {
+        if (failures < 5) {
+          fprintf(stderr, "FAIL: edit %zu (%s, %s) differs from a full re-lex at token %zu of %zu. Input:\n%.*s\n",
+                  done, zero_copy ? "zero_copy" : "copying", in_place ? "in place" : "new buffer",
+                  i, full.length, (int)length, data);
+        }
+        failures++;
+        break;
+      }
+    }
+    if (data != buffer) free(data);
+    sdm_arena_rewind(&main_arena, mark);
+  }
+
+  printf("tokenise_edit: %zu edits, %zu failures\n", edit_count, failures);
+  free(buffer);
+  free(inserted);
+  app_arena_free();
+  return failures > 0;
+}